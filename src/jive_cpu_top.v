@@ -132,7 +132,7 @@ module jive_cpu_top
     `ifdef verilator3
     // Instruction disassembly for impulse
     reg [31:0] r_dasm_f [0:7];
-    import "DPI-C" function byte riscv_disasm(input int instr, input int pc, input int idx);
+    import "DPI-C" context function void riscv_disasm(input int instr, input int pc, output bit [255:0] dasm);
     /*
     // JavaScript code for impulse:
     for (var iter = new SamplesIterator(input); iter.hasNext(); )
@@ -167,7 +167,7 @@ module jive_cpu_top
     
     always @ (posedge rst or posedge clk) begin : INST_FETCH
         integer i;
-        reg [7:0] _dasm [0:31];
+        reg [255:0] _dasm;
     
         if (rst) begin
             r_inst_reg_f <= { 12'b0, 5'b0, 3'b0, 5'b0, 7'b00100_11 }; // NOP
@@ -179,17 +179,10 @@ module jive_cpu_top
             if (r_cpu_fsm[FSM_FETCH] & dtack) begin
                 r_inst_reg_f <= rdata;
                 `ifdef verilator3
-                for (i = 0; i < 32; i = i + 1) begin
-                    _dasm[i] = riscv_disasm(rdata, addr, i);
+                riscv_disasm(rdata, addr, _dasm);
+                for (i = 0; i < 8; i = i + 1) begin
+                    r_dasm_f[i] = _dasm[i*32 +: 32];
                 end
-                r_dasm_f[0] = { _dasm[ 3], _dasm[ 2], _dasm[ 1], _dasm[ 0] };
-                r_dasm_f[1] = { _dasm[ 7], _dasm[ 6], _dasm[ 5], _dasm[ 4] };
-                r_dasm_f[2] = { _dasm[11], _dasm[10], _dasm[ 9], _dasm[ 8] };
-                r_dasm_f[3] = { _dasm[15], _dasm[14], _dasm[13], _dasm[12] };
-                r_dasm_f[4] = { _dasm[19], _dasm[18], _dasm[17], _dasm[16] };
-                r_dasm_f[5] = { _dasm[23], _dasm[22], _dasm[21], _dasm[20] };
-                r_dasm_f[6] = { _dasm[27], _dasm[26], _dasm[25], _dasm[24] };
-                r_dasm_f[7] = { _dasm[31], _dasm[30], _dasm[29], _dasm[28] };
                 `endif
             end
         end
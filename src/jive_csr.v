@@ -27,12 +27,39 @@ module jive_csr
     reg  [2:0] r_csr_mip;
     reg        r_isr_on;
     
+    `ifdef verilator3
+    // Interrupts enable changed by the testbench (ISS hand-off)
+    import "DPI-C" context function int reset_mie(input int mie);
+    
+    reg  [2:0] r_reset_mie;
+    
+    initial begin : RESET_MIE_INIT
+        int tmp;
+        
+        tmp = reset_mie(32'd0);
+        r_reset_mie = tmp[2:0];
+    end
+    
+    // Testbench time skip (+idleskip) : cycle counter moved forward
+    export "DPI-C" function csr_skip;
+    
+    function void csr_skip(input longint cycles);
+        /* verilator lint_off BLKANDNBLK */
+        r_csr_mcycle = r_csr_mcycle + cycles;
+        /* verilator lint_on BLKANDNBLK */
+    endfunction
+    `endif
+    
     always @ (posedge rst or posedge clk) begin : CSR_WRITE
         reg [3:1] v_inc;
     
         if (rst) begin
             r_csr_mcycle <= 64'd0;
+            `ifdef verilator3
+            r_csr_mie    <= r_reset_mie;
+            `else
             r_csr_mie    <= 3'b000;
+            `endif
             r_csr_mip    <= 3'b000;
             r_isr_on     <= 1'b0;
             //v_inc        <= 3'b000;
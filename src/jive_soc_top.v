@@ -2,6 +2,8 @@ module jive_soc_top
 (
     input             clk,      // 46B (#35) : 12 MHz clock input
     `ifdef verilator3
+    // Simulation reset (model reused between tests)
+    input             sim_rst,
     // Instruction fetch
     output            i_rd_ack,
     output     [31:0] i_address,
@@ -43,6 +45,12 @@ module jive_soc_top
     
     always @ (posedge clk) begin : RESET_GEN
     
+        `ifdef verilator3
+        if (sim_rst) begin
+            r_rst_ctr <= 4'd0;
+        end
+        else
+        `endif
         if (!r_rst_ctr[3]) begin
             r_rst_ctr <= r_rst_ctr + 4'd1;
         end
@@ -21,14 +21,46 @@ module jive_timer
     reg [63:0] r_mtime;
     reg [63:0] r_mtimecmp;
     reg        r_tmr_int;
+    
+    `ifdef verilator3
+    // Timer registers changed by the testbench (ISS hand-off)
+    import "DPI-C" context function longint reset_timer(input int index, input longint value);
+    
+    reg [63:0] r_reset_mtime;
+    reg [63:0] r_reset_mtimecmp;
+    
+    initial begin : RESET_TIMER_INIT
+        r_reset_mtime    = reset_timer(0, 64'h00000000_00000000);
+        r_reset_mtimecmp = reset_timer(1, 64'hFFFFFFFF_FFFFFFFF);
+    end
+    
+    // Testbench time skip (+idleskip) : mtime (index 0) / mtimecmp (index 1) read, mtime moved forward
+    export "DPI-C" function timer_read;
+    export "DPI-C" function timer_skip;
+    
+    function longint timer_read(input int index);
+        timer_read = (index[0]) ? r_mtimecmp : r_mtime;
+    endfunction
+    
+    function void timer_skip(input longint ticks);
+        /* verilator lint_off BLKANDNBLK */
+        r_mtime = r_mtime + ticks;
+        /* verilator lint_on BLKANDNBLK */
+    endfunction
+    `endif
 
     always @(posedge rst or posedge clk) begin : TIMER_WR_REGS
         reg [2:0] v_rtc_cc;
         reg [3:1] v_inc;
     
         if (rst) begin
+            `ifdef verilator3
+            r_mtime    <= r_reset_mtime;
+            r_mtimecmp <= r_reset_mtimecmp;
+            `else
             r_mtime    <= 64'h00000000_00000000;
             r_mtimecmp <= 64'hFFFFFFFF_FFFFFFFF;
+            `endif
             r_tmr_int  <= 1'b0;
             v_rtc_cc   <= 3'b000;
             v_inc      <= 3'b000;
@@ -183,20 +183,31 @@ module jive_uart
         end
     end
     
+    `ifdef verilator3
+    // Testbench input (+uartin) : received byte not read yet, byte written
+    // directly into the holding register (+uartfast)
+    export "DPI-C" function uart_rx_full;
+    export "DPI-C" function uart_rx_put;
+    
+    function int uart_rx_full();
+        uart_rx_full = (r_rx_rdy) ? 1 : 0;
+    endfunction
+    
+    function void uart_rx_put(input int data);
+        /* verilator lint_off BLKANDNBLK */
+        r_rx_data = data[7:0];
+        r_rx_rdy  = 1'b1;
+        /* verilator lint_on BLKANDNBLK */
+    endfunction
+    `endif
+    
     //=========================================================================
     // 8N1 byte transmit
     //=========================================================================    
     
     `ifdef verilator3
-    integer _uart_fh_out;
-    
-    initial begin
-        _uart_fh_out = $fopen("uart_tx.log", "w");
-        if (_uart_fh_out == 0) begin
-            $display("File uart_tx.log open error %d\n", _uart_fh_out);
-            $finish;
-        end
-    end
+    // Testbench output (uart_tx.log, kept by the checkpoints)
+    import "DPI-C" context function void uart_tx(input int data);
     `endif
     
     reg  [10:0] r_tx_data;  // Transmitted data, 8N1 format
@@ -214,7 +225,7 @@ module jive_uart
                     if (csel & wren & bena[0]) begin
                         // Testbench output
                         `ifdef verilator3
-                        $fwrite(_uart_fh_out, "%c", wdata[7:0]);
+                        uart_tx({ 24'd0, wdata[7:0] });
                         `endif
                         // Load shift register :
                         // Stop(1) | Byte | Start(0) | Idle (1)
@@ -232,4 +243,15 @@ module jive_uart
     
     assign uart_txd = r_tx_data[0];
     
+    `ifdef verilator3
+    // Testbench time skip (+idleskip) : nothing to send, the receiver waits
+    // for a transition of a stable line (only the baud rate counters run)
+    export "DPI-C" function uart_idle;
+    
+    function int uart_idle();
+        uart_idle = (r_tx_rdy & ~r_rx_vld & (r_uart_rxd_cc == {3{uart_rxd}})
+                  & (r_rx_fsm[FSM_RX_IDLE] & uart_rxd | r_rx_fsm[FSM_RX_STOP] & ~uart_rxd)) ? 1 : 0;
+    endfunction
+    `endif
+    
 endmodule
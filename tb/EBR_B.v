@@ -47,11 +47,33 @@ module EBR_B
     // MEMORY BLOCK INITIALIZATION //
     /////////////////////////////////
     
-    reg [15:0] r_ram_blk [0:255];
+    // 256 x 16-bit words owned by the testbench : the initial contents
+    // (INIT_x, changed by the ISS hand-off) are given to ebr_init()
+    import "DPI-C" context function int  ebr_mem();
+    import "DPI-C" context function void ebr_init(input int index, input int data);
+    import "DPI-C" function int  ebr_read(input int mem, input int addr);
+    import "DPI-C" function void ebr_write(input int mem, input int addr, input int data, input int mask);
+    // Memory attached again (restored checkpoint), initial contents set again (JiveSim::reset())
+    export "DPI-C" function ebr_attach;
+    export "DPI-C" function ebr_reload;
     
-    initial begin : SBRAM_INIT
+    int r_mem;
+    
+    // Last write, committed into the testbench memory on the next edge :
+    // the read port gets the same data whatever the order of the two ports
+    reg        r_wr_pend;
+    reg  [7:0] r_wr_addr;
+    reg [15:0] r_wr_data;
+    reg [15:0] r_wr_mask;
+    
+    function void ebr_attach();
+        r_mem = ebr_mem();
+    endfunction
+    
+    function void ebr_reload();
         reg [255:0] v_tmp [0:15];
         integer i;
+        integer j;
         
         v_tmp[4'h0] = INIT_0;
         v_tmp[4'h1] = INIT_1;
@@ -70,41 +92,21 @@ module EBR_B
         v_tmp[4'hE] = INIT_E;
         v_tmp[4'hF] = INIT_F;
         
-        for (i = 0; i < 256; i = i + 16) begin
-            r_ram_blk[{ 4'h0, i[7:4] }] = v_tmp[4'h0][15:0];
-            r_ram_blk[{ 4'h1, i[7:4] }] = v_tmp[4'h1][15:0];
-            r_ram_blk[{ 4'h2, i[7:4] }] = v_tmp[4'h2][15:0];
-            r_ram_blk[{ 4'h3, i[7:4] }] = v_tmp[4'h3][15:0];
-            r_ram_blk[{ 4'h4, i[7:4] }] = v_tmp[4'h4][15:0];
-            r_ram_blk[{ 4'h5, i[7:4] }] = v_tmp[4'h5][15:0];
-            r_ram_blk[{ 4'h6, i[7:4] }] = v_tmp[4'h6][15:0];
-            r_ram_blk[{ 4'h7, i[7:4] }] = v_tmp[4'h7][15:0];
-            r_ram_blk[{ 4'h8, i[7:4] }] = v_tmp[4'h8][15:0];
-            r_ram_blk[{ 4'h9, i[7:4] }] = v_tmp[4'h9][15:0];
-            r_ram_blk[{ 4'hA, i[7:4] }] = v_tmp[4'hA][15:0];
-            r_ram_blk[{ 4'hB, i[7:4] }] = v_tmp[4'hB][15:0];
-            r_ram_blk[{ 4'hC, i[7:4] }] = v_tmp[4'hC][15:0];
-            r_ram_blk[{ 4'hD, i[7:4] }] = v_tmp[4'hD][15:0];
-            r_ram_blk[{ 4'hE, i[7:4] }] = v_tmp[4'hE][15:0];
-            r_ram_blk[{ 4'hF, i[7:4] }] = v_tmp[4'hF][15:0];
-            
-            v_tmp[4'h0] = v_tmp[4'h0] >> 16;
-            v_tmp[4'h1] = v_tmp[4'h1] >> 16;
-            v_tmp[4'h2] = v_tmp[4'h2] >> 16;
-            v_tmp[4'h3] = v_tmp[4'h3] >> 16;
-            v_tmp[4'h4] = v_tmp[4'h4] >> 16;
-            v_tmp[4'h5] = v_tmp[4'h5] >> 16;
-            v_tmp[4'h6] = v_tmp[4'h6] >> 16;
-            v_tmp[4'h7] = v_tmp[4'h7] >> 16;
-            v_tmp[4'h8] = v_tmp[4'h8] >> 16;
-            v_tmp[4'h9] = v_tmp[4'h9] >> 16;
-            v_tmp[4'hA] = v_tmp[4'hA] >> 16;
-            v_tmp[4'hB] = v_tmp[4'hB] >> 16;
-            v_tmp[4'hC] = v_tmp[4'hC] >> 16;
-            v_tmp[4'hD] = v_tmp[4'hD] >> 16;
-            v_tmp[4'hE] = v_tmp[4'hE] >> 16;
-            v_tmp[4'hF] = v_tmp[4'hF] >> 16;
+        // No write left from the previous test, word <i> of INIT_<j> at address { j, i }
+        /* verilator lint_off BLKANDNBLK */
+        r_wr_pend = 1'b0;
+        /* verilator lint_on BLKANDNBLK */
+        for (i = 0; i < 16; i = i + 1) begin
+            for (j = 0; j < 16; j = j + 1) begin
+                ebr_init({ 24'd0, j[3:0], i[3:0] }, { 16'h0000, v_tmp[j][15:0] });
+                v_tmp[j] = v_tmp[j] >> 16;
+            end
         end
+    endfunction
+    
+    initial begin : SBRAM_INIT
+        ebr_attach();
+        ebr_reload();
     end
 
     ////////////////
@@ -112,15 +114,14 @@ module EBR_B
     ////////////////
     
     always@(posedge WCLK) begin : WRITE_PORT
-        integer i;
     
-        if (WCLKE & WE) begin
-            for (i = 0; i < 16; i = i + 1) begin
-                if (w_wmask[i]) begin
-                    r_ram_blk[w_waddr][i] <= w_wdata[i];
-                end
-            end
+        if (r_wr_pend) begin
+            ebr_write(r_mem, { 24'd0, r_wr_addr }, { 16'h0000, r_wr_data }, { 16'h0000, r_wr_mask });
         end
+        r_wr_pend <= WCLKE & WE;
+        r_wr_addr <= w_waddr;
+        r_wr_data <= w_wdata;
+        r_wr_mask <= w_wmask;
     end
     
     ///////////////
@@ -130,9 +131,15 @@ module EBR_B
     reg [15:0] r_rdata_p1;
     
     always@(posedge RCLK) begin : READ_PORT
+        int v_tmp;
     
         if (RCLKE & RE) begin
-            r_rdata_p1 <= r_ram_blk[w_raddr];
+            v_tmp = ebr_read(r_mem, { 24'd0, w_raddr });
+            // Write not committed yet
+            if (r_wr_pend && (r_wr_addr == w_raddr)) begin
+                v_tmp[15:0] = v_tmp[15:0] & ~r_wr_mask | r_wr_data & r_wr_mask;
+            end
+            r_rdata_p1 <= v_tmp[15:0];
         end
     end
     
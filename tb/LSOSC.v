@@ -25,5 +25,24 @@ module LSOSC
     end
     
     assign CLKLF = _ctr[10] & CLKLFEN;
+    
+    `ifdef verilator3
+    // Testbench time skip (+idleskip) : CLKLF edges over the next cycles, counter moved forward
+    export "DPI-C" function lsosc_edges;
+    export "DPI-C" function lsosc_skip;
+    
+    function longint lsosc_edges(input longint cycles);
+        longint v_ctr;
+        
+        v_ctr = { 32'd0, _ctr };
+        lsosc_edges = (CLKLFPU & CLKLFEN) ? ((v_ctr + cycles) >> 10) - (v_ctr >> 10) : 64'd0;
+    endfunction
+    
+    function void lsosc_skip(input longint cycles);
+        /* verilator lint_off BLKANDNBLK */
+        if (CLKLFPU) _ctr = _ctr + cycles[31:0];
+        /* verilator lint_on BLKANDNBLK */
+    endfunction
+    `endif
 
 endmodule
@@ -15,57 +15,45 @@ module SP256K
 );
     parameter HIWORD = 0;
 
-    /////////////////////////////////
-    // MEMORY BLOCK INITIALIZATION //
-    /////////////////////////////////
+    ////////////////////////////
+    // TESTBENCH MEMORY BLOCK //
+    ////////////////////////////
     
-    import "DPI-C" function int spram_init(input int index);
+    // 64 KB RAM owned by the testbench, shared by the two instances :
+    // HIWORD selects the 16-bit half of each 32-bit word
+    import "DPI-C" context function int spram_mem(input int hiword);
+    import "DPI-C" function int  spram_read(input int mem, input int addr);
+    import "DPI-C" function void spram_write(input int mem, input int addr, input int data, input int mask);
+    // Memory attached again by the testbench (restored checkpoint)
+    export "DPI-C" function spram_attach;
     
-    reg [3:0] r_ram_blk_0 [0:16383];
-    reg [3:0] r_ram_blk_1 [0:16383];
-    reg [3:0] r_ram_blk_2 [0:16383];
-    reg [3:0] r_ram_blk_3 [0:16383];
+    int r_mem;
+    
+    function void spram_attach();
+        r_mem = spram_mem(HIWORD);
+    endfunction
     
     initial begin : SPRAM_INIT
-        int i;
-        int tmp;
-        
-        for (i = 0; i < 16384; i = i + 1) begin
-            tmp = spram_init(i);
-            r_ram_blk_3[i] = (HIWORD[0]) ? tmp[31:28] : tmp[15:12];
-            r_ram_blk_2[i] = (HIWORD[0]) ? tmp[27:24] : tmp[11: 8];
-            r_ram_blk_1[i] = (HIWORD[0]) ? tmp[23:20] : tmp[ 7: 4];
-            r_ram_blk_0[i] = (HIWORD[0]) ? tmp[19:16] : tmp[ 3: 0];
-        end
+        spram_attach();
     end
 
-    ////////////////
-    // WRITE PORT //
-    ////////////////
-    
-    always@(posedge CK) begin : WRITE_PORT
-    
-        if (CS & WE) begin
-            if (MASKWE[3]) r_ram_blk_3[AD] <= DI[15:12];
-            if (MASKWE[2]) r_ram_blk_2[AD] <= DI[11: 8];
-            if (MASKWE[1]) r_ram_blk_1[AD] <= DI[ 7: 4];
-            if (MASKWE[0]) r_ram_blk_0[AD] <= DI[ 3: 0];
-        end
-    end
-    
-    ///////////////
-    // READ PORT //
-    ///////////////
+    //////////////////////////
+    // READ AND WRITE PORTS //
+    //////////////////////////
     
     reg [15:0] r_dataout_p1;
     
-    always@(posedge CK) begin : READ_PORT
+    always@(posedge CK) begin : RAM_PORTS
+        int v_tmp;
     
         if (CS) begin
-            r_dataout_p1[15:12] <= r_ram_blk_3[AD];
-            r_dataout_p1[11: 8] <= r_ram_blk_2[AD];
-            r_dataout_p1[ 7: 4] <= r_ram_blk_1[AD];
-            r_dataout_p1[ 3: 0] <= r_ram_blk_0[AD];
+            // Read before write (old data on the output)
+            v_tmp = spram_read(r_mem, { 18'd0, AD });
+            r_dataout_p1 <= v_tmp[15:0];
+            
+            if (WE) begin
+                spram_write(r_mem, { 18'd0, AD }, { 16'h0000, DI }, { 28'd0, MASKWE });
+            end
         end
     end
     
@@ -0,0 +1,30 @@
+#! /bin/sh
+
+#Simulated cycles per second of the models built by compile.sh :
+#single-threaded (obj_dir) and multi-threaded variants (obj_dir_t<N>)
+#The fastest one is installed as riscv-compliance/riscv-jivesim/Vjive_soc_top_fast
+
+#Verilog top module
+TOP_FILE=jive_soc_top
+
+#Benchmark parameters (program, simulated time)
+BENCH_OPT="+bench +srec=test.srec +syms=test.syms +trc=bench +msec=10"
+
+BEST_RATE=0
+BEST_DIR=
+for DIR in obj_dir obj_dir_t*
+do
+    if [ -x ./$DIR/V$TOP_FILE ]; then
+        RATE=`./$DIR/V$TOP_FILE $BENCH_OPT | tr '\r' '\n' | awk '/^Benchmark/ { print $(NF-1) }'`
+        echo "$DIR : $RATE cycles/s"
+        if [ -n "$RATE" ] && [ "$RATE" -gt "$BEST_RATE" ]; then
+            BEST_RATE=$RATE
+            BEST_DIR=$DIR
+        fi
+    fi
+done
+
+if [ -n "$BEST_DIR" ]; then
+    echo "Fastest model : $BEST_DIR ($BEST_RATE cycles/s)"
+    cp ./$BEST_DIR/V$TOP_FILE ../riscv-compliance/riscv-jivesim/V${TOP_FILE}_fast
+fi
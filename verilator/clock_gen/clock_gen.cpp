@@ -7,35 +7,49 @@
 // Constructor
 ClockGen::ClockGen(int num_clk, vluint64_t end_ps)
 {
+    size_t size;
+    
     num_clock      = num_clk;
+    num_heap       = 0;
     end_stamp_ps   = (vluint64_t)end_ps;
-    max_stamp_ps   = (vluint64_t)0;
     curr_stamp_ps  = (vluint64_t)0;
-    next_stamp_ps  = (vluint64_t)0;
-    p_clk_stamp_ps = new vluint64_t[num_clk];
-    p_clk_phase_ps = new vluint64_t[num_clk];
-    p_clk_hper_ps  = new vluint64_t[num_clk];
-    p_clk_state    = new vluint8_t[num_clk];
-    p_clk_enable   = new bool[num_clk];
+    
+    // 64-bit fields first, then pointers, 32-bit and 8-bit fields
+    size = (size_t)num_clk * (3 * sizeof(vluint64_t) + sizeof(clk_edge_cb_t) + sizeof(void *)
+                            + 3 * sizeof(int) + 3 * sizeof(vluint8_t));
+    p_clk_mem      = new vluint8_t[(size) ? size : 1];
+    p_clk_stamp_ps = (vluint64_t *)p_clk_mem;
+    p_clk_phase_ps = p_clk_stamp_ps + num_clk;
+    p_clk_hper_ps  = p_clk_phase_ps + num_clk;
+    p_clk_cb       = (clk_edge_cb_t *)(p_clk_hper_ps + num_clk);
+    p_clk_user     = (void **)(p_clk_cb + num_clk);
+    p_heap_clk     = (int *)(p_clk_user + num_clk);
+    p_heap_pos     = p_heap_clk + num_clk;
+    p_edge_clk     = p_heap_pos + num_clk;
+    p_clk_state    = (vluint8_t *)(p_edge_clk + num_clk);
+    p_clk_cb_edge  = p_clk_state + num_clk;
+    p_clk_enable   = p_clk_cb_edge + num_clk;
     
     for (int i = 0; i < num_clk; i++)
     {
         p_clk_stamp_ps[i] = (vluint64_t)0;
         p_clk_phase_ps[i] = (vluint64_t)0;
         p_clk_hper_ps[i]  = (vluint64_t)0;
+        p_clk_cb[i]       = NULL;
+        p_clk_user[i]     = NULL;
+        p_heap_clk[i]     = -1;
+        p_heap_pos[i]     = -1;
+        p_edge_clk[i]     = -1;
         p_clk_state[i]    = (vluint8_t)0;
-        p_clk_enable[i]   = false;
+        p_clk_cb_edge[i]  = (vluint8_t)0;
+        p_clk_enable[i]   = (vluint8_t)0;
     }
 }
 
 // Destructor
 ClockGen::~ClockGen()
 {
-    delete [] p_clk_stamp_ps;
-    delete [] p_clk_phase_ps;
-    delete [] p_clk_hper_ps;
-    delete [] p_clk_state;
-    delete [] p_clk_enable;
+    delete [] p_clk_mem;
 }
 
 // Create a new clock
@@ -45,10 +59,6 @@ void ClockGen::NewClock(int clk_idx, vluint64_t period_ps, vluint64_t phase_ps)
     {
         p_clk_phase_ps[clk_idx] = phase_ps;
         p_clk_hper_ps[clk_idx] = period_ps / 2;
-        if ((max_stamp_ps * 2) < period_ps)
-        {
-            max_stamp_ps = period_ps / 2 + 1;
-        }
     }
 }
 
@@ -62,7 +72,9 @@ void ClockGen::StartClock(int clk_idx)
         // Next edge : one half period later
         p_clk_stamp_ps[clk_idx] = curr_stamp_ps + p_clk_hper_ps[clk_idx];
         // Enable the clock if the half period is not null
-        p_clk_enable[clk_idx] = (p_clk_hper_ps[clk_idx]) ? true : false;
+        p_clk_enable[clk_idx] = (p_clk_hper_ps[clk_idx]) ? 1 : 0;
+        HeapRemove(clk_idx);
+        if (p_clk_enable[clk_idx]) HeapInsert(clk_idx);
         
         printf("StartClock(%d) : time = %lld, phase = 0, stamp = %lld\n",
                clk_idx, curr_stamp_ps, p_clk_stamp_ps[clk_idx]);
@@ -78,13 +90,10 @@ void ClockGen::StartClock(int clk_idx, vluint64_t phase_ps)
         p_clk_state[clk_idx] = (vluint8_t)0;
         // Rising edge : phase shift + one half period later
         p_clk_stamp_ps[clk_idx] = curr_stamp_ps + p_clk_hper_ps[clk_idx] + phase_ps;
-        // Adjust next time stamp if necessary
-        if (p_clk_stamp_ps[clk_idx] < next_stamp_ps)
-        {
-            next_stamp_ps = p_clk_stamp_ps[clk_idx];
-        }
         // Enable the clock if the half period is not null
-        p_clk_enable[clk_idx] = (p_clk_hper_ps[clk_idx]) ? true : false;
+        p_clk_enable[clk_idx] = (p_clk_hper_ps[clk_idx]) ? 1 : 0;
+        HeapRemove(clk_idx);
+        if (p_clk_enable[clk_idx]) HeapInsert(clk_idx);
         
         printf("StartClock(%d) : time = %lld, phase = %lld, stamp = %lld\n",
                clk_idx, curr_stamp_ps, phase_ps, p_clk_stamp_ps[clk_idx]);
@@ -96,7 +105,19 @@ void ClockGen::StopClock(int clk_idx)
 {
     if (clk_idx < num_clock)
     {
-        p_clk_enable[clk_idx] = false;
+        p_clk_enable[clk_idx] = 0;
+        HeapRemove(clk_idx);
+    }
+}
+
+// Call a function on the rising, falling or both edges of a clock (cb = NULL : no callback)
+void ClockGen::SetEdgeCallback(int clk_idx, int edge, clk_edge_cb_t cb, void *user)
+{
+    if (clk_idx < num_clock)
+    {
+        p_clk_cb[clk_idx]      = cb;
+        p_clk_user[clk_idx]    = user;
+        p_clk_cb_edge[clk_idx] = (vluint8_t)(edge & CLK_EDGE_BOTH);
     }
 }
 
@@ -160,31 +181,80 @@ vluint64_t ClockGen::GetTimeStampPs()
     return curr_stamp_ps;
 }
 
-// Update clock states, compute next time stamp
-void ClockGen::AdvanceClocks()
+// Move to the next clock edge(s), update clock states and call the edge callbacks
+// (returns false if no clock is running : the time stamp goes to the end of simulation)
+bool ClockGen::AdvanceClocks()
 {
-    curr_stamp_ps = next_stamp_ps;
-    next_stamp_ps += max_stamp_ps;
+    int num_edge;
     
-    for (int i = 0; i < num_clock; i++)
+    if (!num_heap)
+    {
+        curr_stamp_ps = end_stamp_ps;
+        return false;
+    }
+    
+    // Clocks with an edge at the earliest time stamp
+    curr_stamp_ps = p_clk_stamp_ps[p_heap_clk[0]];
+    num_edge = 0;
+    while ((num_heap) && (p_clk_stamp_ps[p_heap_clk[0]] == curr_stamp_ps))
     {
-        if (p_clk_enable[i])
+        int i = p_heap_clk[0];
+        
+        // Update clock state, schedule its next edge
+        p_clk_state[i]++;
+        p_clk_stamp_ps[i] += p_clk_hper_ps[i];
+        HeapDown(0);
+        p_edge_clk[num_edge++] = i;
+    }
+    
+    // Callbacks once all the clocks are up to date
+    for (int j = 0; j < num_edge; j++)
+    {
+        int i = p_edge_clk[j];
+        
+        if ((p_clk_cb[i]) && (p_clk_cb_edge[i] & ((p_clk_state[i] & 1) ? CLK_EDGE_RISE : CLK_EDGE_FALL)))
         {
-            // Update clock state
-            if (p_clk_stamp_ps[i] == curr_stamp_ps)
-            {
-                p_clk_state[i]++;
-                p_clk_stamp_ps[i] += p_clk_hper_ps[i];
-            }
-            // Find next time stamp
-            if (p_clk_stamp_ps[i] < next_stamp_ps)
-            {
-                next_stamp_ps = p_clk_stamp_ps[i];
-            }
+            p_clk_cb[i](p_clk_user[i], i, p_clk_state[i]);
         }
     }
     
-    // Show progress
+    ShowProgress();
+    
+    return true;
+}
+
+// Return true if this clock is the only running one (cycle stepping)
+bool ClockGen::SingleClock(int clk_idx)
+{
+    return ((num_heap == 1) && (p_heap_clk[0] == clk_idx));
+}
+
+// Cycle stepping : next edge of the only running clock, without the edges queue
+// and the callbacks (the caller drives the clock input), returns the new clock state
+vluint8_t ClockGen::AdvanceEdge(int clk_idx)
+{
+    curr_stamp_ps = p_clk_stamp_ps[clk_idx];
+    p_clk_stamp_ps[clk_idx] += p_clk_hper_ps[clk_idx];
+    
+    ShowProgress();
+    
+    return ++p_clk_state[clk_idx];
+}
+
+// Time skip : <num> periods of the only running clock without any edge
+// (same clock phase and divided clock states afterwards)
+void ClockGen::SkipCycles(int clk_idx, vluint64_t num)
+{
+    vluint64_t skip_ps = num * (p_clk_hper_ps[clk_idx] << 1);
+    
+    curr_stamp_ps += skip_ps;
+    p_clk_stamp_ps[clk_idx] += skip_ps;
+    p_clk_state[clk_idx] += (vluint8_t)(num << 1);
+}
+
+// Show progress
+void ClockGen::ShowProgress()
+{
     if ((curr_stamp_ps & 0x3FFFF) == 0)
     {
         printf("\r%lld us", curr_stamp_ps / 1000000 );
@@ -196,4 +266,121 @@ void ClockGen::AdvanceClocks()
 bool ClockGen::EndOfSimulation()
 {
     return (curr_stamp_ps >= end_stamp_ps);
-}
\ No newline at end of file
+}
+
+// Earlier edge first, lower clock index first for the same time stamp
+bool ClockGen::HeapLess(int clk_a, int clk_b)
+{
+    if (p_clk_stamp_ps[clk_a] != p_clk_stamp_ps[clk_b])
+        return (p_clk_stamp_ps[clk_a] < p_clk_stamp_ps[clk_b]);
+    else
+        return (clk_a < clk_b);
+}
+
+// Exchange two entries of the edges queue
+void ClockGen::HeapSwap(int pos_a, int pos_b)
+{
+    int clk_a = p_heap_clk[pos_a];
+    int clk_b = p_heap_clk[pos_b];
+    
+    p_heap_clk[pos_a] = clk_b;
+    p_heap_clk[pos_b] = clk_a;
+    p_heap_pos[clk_b] = pos_a;
+    p_heap_pos[clk_a] = pos_b;
+}
+
+// Move an entry of the edges queue towards the root
+void ClockGen::HeapUp(int pos)
+{
+    while (pos > 0)
+    {
+        int parent = (pos - 1) >> 1;
+        
+        if (!HeapLess(p_heap_clk[pos], p_heap_clk[parent])) break;
+        HeapSwap(pos, parent);
+        pos = parent;
+    }
+}
+
+// Move an entry of the edges queue towards the leaves
+void ClockGen::HeapDown(int pos)
+{
+    for (;;)
+    {
+        int child = (pos << 1) + 1;
+        
+        if (child >= num_heap) break;
+        if ((child + 1 < num_heap) && (HeapLess(p_heap_clk[child + 1], p_heap_clk[child]))) child++;
+        if (!HeapLess(p_heap_clk[child], p_heap_clk[pos])) break;
+        HeapSwap(pos, child);
+        pos = child;
+    }
+}
+
+// Add a clock to the edges queue
+void ClockGen::HeapInsert(int clk_idx)
+{
+    p_heap_clk[num_heap] = clk_idx;
+    p_heap_pos[clk_idx]  = num_heap;
+    HeapUp(num_heap++);
+}
+
+// Remove a clock from the edges queue
+void ClockGen::HeapRemove(int clk_idx)
+{
+    int pos = p_heap_pos[clk_idx];
+    
+    if (pos < 0) return;
+    
+    HeapSwap(pos, --num_heap);
+    p_heap_pos[clk_idx] = -1;
+    if (pos < num_heap)
+    {
+        int moved = p_heap_clk[pos];
+        
+        HeapUp(pos);
+        HeapDown(p_heap_pos[moved]);
+    }
+}
+
+// Save the clocks' time stamps and states into a checkpoint
+// (the end of simulation time stamp and the callbacks are not saved)
+void ClockGen::SaveState(VerilatedSerialize &os)
+{
+    os.write(&num_clock, sizeof(num_clock));
+    os.write(&curr_stamp_ps, sizeof(curr_stamp_ps));
+    os.write(p_clk_stamp_ps, num_clock * sizeof(vluint64_t));
+    os.write(p_clk_phase_ps, num_clock * sizeof(vluint64_t));
+    os.write(p_clk_hper_ps, num_clock * sizeof(vluint64_t));
+    os.write(p_clk_state, num_clock * sizeof(vluint8_t));
+    os.write(p_clk_enable, num_clock * sizeof(vluint8_t));
+}
+
+// Restore the clocks' time stamps and states from a checkpoint
+int ClockGen::RestoreState(VerilatedDeserialize &is)
+{
+    int num_clk;
+    
+    is.read(&num_clk, sizeof(num_clk));
+    if (num_clk != num_clock)
+    {
+        printf("Checkpoint has %d clocks instead of %d !\n", num_clk, num_clock);
+        return -1;
+    }
+    is.read(&curr_stamp_ps, sizeof(curr_stamp_ps));
+    is.read(p_clk_stamp_ps, num_clock * sizeof(vluint64_t));
+    is.read(p_clk_phase_ps, num_clock * sizeof(vluint64_t));
+    is.read(p_clk_hper_ps, num_clock * sizeof(vluint64_t));
+    is.read(p_clk_state, num_clock * sizeof(vluint8_t));
+    is.read(p_clk_enable, num_clock * sizeof(vluint8_t));
+    
+    // Edges queue of the running clocks
+    num_heap = 0;
+    for (int i = 0; i < num_clock; i++)
+    {
+        p_heap_pos[i] = -1;
+        if (p_clk_enable[i]) HeapInsert(i);
+    }
+    
+    return 0;
+}
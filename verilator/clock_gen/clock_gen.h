@@ -1,8 +1,16 @@
-
 #ifndef _CLOCK_GEN_H_
 #define _CLOCK_GEN_H_
 
 #include "verilated.h"
+#include "verilated_save.h"
+
+// Clock edges selected for a callback
+#define CLK_EDGE_RISE   (1)
+#define CLK_EDGE_FALL   (2)
+#define CLK_EDGE_BOTH   (3)
+
+// Callback on a clock edge : user data, clock index, new clock state (bit #0 : clock level)
+typedef void (*clk_edge_cb_t)(void *user, int clk_idx, vluint8_t state);
 
 class ClockGen
 {
@@ -15,6 +23,7 @@ class ClockGen
         void        StartClock(int clk_idx);
         void        StartClock(int clk_idx, vluint64_t phase_ps);
         void        StopClock(int clk_idx);
+        void        SetEdgeCallback(int clk_idx, int edge, clk_edge_cb_t cb, void *user);
         vluint8_t   GetClockStateDiv1(int clk_idx, vluint8_t phase); // phase : 0 - 1
         vluint8_t   GetClockStateDiv2(int clk_idx, vluint8_t phase); // phase : 0 - 3
         vluint8_t   GetClockStateDiv4(int clk_idx, vluint8_t phase); // phase : 0 - 7
@@ -22,19 +31,39 @@ class ClockGen
         vluint8_t   GetClockStateDiv16(int clk_idx, vluint8_t phase); // phase : 0 - 31
         vluint8_t   GetClockStateDiv32(int clk_idx, vluint8_t phase); // phase : 0 - 63
         vluint64_t  GetTimeStampPs();
-        void        AdvanceClocks();
+        bool        AdvanceClocks();
+        bool        SingleClock(int clk_idx);
+        vluint8_t   AdvanceEdge(int clk_idx);
+        void        SkipCycles(int clk_idx, vluint64_t num);
         bool        EndOfSimulation();
+        void        SaveState(VerilatedSerialize &os);
+        int         RestoreState(VerilatedDeserialize &is);
     private:
+        void        ShowProgress();
+        // Edges queue (binary min-heap of the enabled clocks, ordered by time stamp)
+        bool        HeapLess(int clk_a, int clk_b);
+        void        HeapSwap(int pos_a, int pos_b);
+        void        HeapUp(int pos);
+        void        HeapDown(int pos);
+        void        HeapInsert(int clk_idx);
+        void        HeapRemove(int clk_idx);
         int         num_clock;      // Number of clocks
+        int         num_heap;       // Clocks in the edges queue
         vluint64_t  end_stamp_ps;   // End of simulation time stamp (in ps)
-        vluint64_t  max_stamp_ps;   // Maximal time stamp step (in ps)
         vluint64_t  curr_stamp_ps;  // Current time stamp (in ps)
-        vluint64_t  next_stamp_ps;  // Next time stamp (in ps)
-        vluint64_t *p_clk_stamp_ps; // Clocks' time stamps (in ps)
+        // Clocks' fields (structure of arrays, one allocation)
+        vluint8_t  *p_clk_mem;
+        vluint64_t *p_clk_stamp_ps; // Clocks' next edge time stamps (in ps)
         vluint64_t *p_clk_phase_ps; // Clocks' phase (in ps)
         vluint64_t *p_clk_hper_ps;  // Clocks' half period (in ps)
+        clk_edge_cb_t *p_clk_cb;    // Clocks' edge callbacks (NULL : none)
+        void      **p_clk_user;     // Clocks' callbacks user data
+        int        *p_heap_clk;     // Edges queue : clock index per heap position
+        int        *p_heap_pos;     // Edges queue : heap position per clock (-1 : stopped)
+        int        *p_edge_clk;     // Clocks with an edge at the current time stamp
         vluint8_t  *p_clk_state;    // Clocks' states (0 - 255)
-        bool       *p_clk_enable;   // Enabled clocks 
+        vluint8_t  *p_clk_cb_edge;  // Clocks' callbacks edges (CLK_EDGE_xxx)
+        vluint8_t  *p_clk_enable;   // Enabled clocks
 };
 
 #endif /* _CLOCK_GEN_H_ */
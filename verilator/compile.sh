@@ -1,7 +1,7 @@
 #! /bin/sh
 
 #Options for GCC compiler
-COMPILE_OPT="-cc -no-decoration -output-split 20000 -output-split-ctrace 10000 -O3 -CFLAGS -Wno-attributes -CFLAGS -O2"
+COMPILE_OPT="-cc -no-decoration -output-split 20000 -output-split-ctrace 10000 -O3 -CFLAGS -Wno-attributes -CFLAGS -O2 -CFLAGS -pthread -LDFLAGS -pthread -LDFLAGS -lz"
 
 #Options for C++ model analysis
 #ANALYSIS_OPT="-stats -Wwarn-IMPERFECTSCH"
@@ -9,22 +9,58 @@ COMPILE_OPT="-cc -no-decoration -output-split 20000 -output-split-ctrace 10000 -
 #Comment this line to disable VCD generation
 TRACE_OPT="-trace -no-trace-params"
 
+#Comment this line to disable the simulation checkpoints (+save, +restore)
+SAVE_OPT="-savable -CFLAGS -DJIVE_SAVABLE"
+
+#Multi-threaded model variants (Verilator --threads <N>), built into obj_dir_t<N>
+#They have no checkpoints support (--savable cannot be used with --threads)
+#Leave it empty to only build the single-threaded model, bench.sh compares them
+THREADS_LIST="2 4"
+
 #Clock signals
 CLOCK_OPT="-clk v.clk"
 
 #Verilog top module
 TOP_FILE=jive_soc_top
 
+#Boot ROM of the C++ SoC model (riscv_sim.cpp), generated from the Verilator table of jive_bootrom.v
+awk -F"'h" '/r_rom_blk\[8.h[0-9A-Fa-f]+\] = 32.h/ { a = $2; sub(/\].*/, "", a); d = $3; sub(/;.*/, "", d); rom[tolower(a)] = toupper(d) }
+END { for (i = 0; i < 256; i++) { k = sprintf("%02x", i); printf("    0x%s%s\n", (k in rom) ? rom[k] : "00000000", (i < 255) ? "," : "") } }' \
+    ../src/jive_bootrom.v > ./riscv_sim/boot_rom.inc
+
 #C++ support files
 CPP_FILES=\
 "main.cpp\
+ ./jive_sim/jive_sim.cpp\
+ ./jive_batch/jive_batch.cpp\
  ./clock_gen/clock_gen.cpp\
  ./riscv_trace/riscv_trace.cpp\
+ ./riscv_trace/riscv_block.cpp\
+ ./riscv_sim/riscv_sim.cpp\
+ ./sym_table/sym_table.cpp\
+ ./mem_load/mem_load.cpp\
+ ./profiler/profiler.cpp\
  verilated_dpi.cpp"
 
-verilator tb_top.v $ANALYSIS_OPT $COMPILE_OPT $CLOCK_OPT $TRACE_OPT -top-module $TOP_FILE -exe $CPP_FILES
+verilator tb_top.v $ANALYSIS_OPT $COMPILE_OPT $CLOCK_OPT $TRACE_OPT $SAVE_OPT -top-module $TOP_FILE -exe $CPP_FILES
 cd ./obj_dir
 #make CXX=clang OBJCACHE=ccache -j -f V$TOP_FILE.mk V$TOP_FILE
 make -j -f V$TOP_FILE.mk V$TOP_FILE
 cp V$TOP_FILE ../../riscv-compliance/riscv-jivesim/
 cd ..
+
+#Multi-threaded variants
+for NUM_THREADS in $THREADS_LIST
+do
+    verilator tb_top.v $ANALYSIS_OPT $COMPILE_OPT $CLOCK_OPT $TRACE_OPT -threads $NUM_THREADS -CFLAGS -DJIVE_THREADS=$NUM_THREADS -Mdir obj_dir_t$NUM_THREADS -top-module $TOP_FILE -exe $CPP_FILES
+    cd ./obj_dir_t$NUM_THREADS
+    make -j -f V$TOP_FILE.mk V$TOP_FILE
+    cd ..
+done
+
+#Binary trace decoder (+trcfmt=bin)
+VERILATOR_INC=`verilator -getenv VERILATOR_ROOT`/include
+g++ -O2 -Wno-attributes -pthread -I$VERILATOR_INC -o ./obj_dir/trace_decode ./trace_decode/trace_decode.cpp ./riscv_trace/riscv_trace.cpp ./riscv_trace/riscv_block.cpp ./sym_table/sym_table.cpp ./mem_load/mem_load.cpp ./profiler/profiler.cpp -lz
+
+#Standalone RISC-V simulator (no Verilog model)
+g++ -O3 -Wno-attributes -pthread -I$VERILATOR_INC -o ./obj_dir/jive_iss ./jive_iss/jive_iss.cpp ./riscv_sim/riscv_sim.cpp ./riscv_trace/riscv_trace.cpp ./riscv_trace/riscv_block.cpp ./sym_table/sym_table.cpp ./mem_load/mem_load.cpp ./profiler/profiler.cpp -lz
@@ -0,0 +1,312 @@
+#include "verilated.h"
+#include "jive_batch.h"
+#include "../sym_table/sym_table.h"
+#include "../mem_load/mem_load.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+// Result names (JIVE_EXIT_xxx codes)
+static const char result_str[3][12] =
+{
+    "PASS", "MISMATCH", "SIGNATURE"
+};
+
+static inline const char *get_result_str(int exit_code)
+{
+    return ((exit_code >= 0) && (exit_code < 3)) ? result_str[exit_code] : "ERROR";
+}
+
+// Constructor
+JiveBatch::JiveBatch(const jive_cfg_t *cfg_p, int jobs)
+{
+    memcpy((void *)&cfg, (const void *)cfg_p, sizeof(cfg));
+    // Features of a single simulation
+    cfg.ffwd_type    = TRG_NONE;
+    cfg.save_name[0] = (char)0;
+    cfg.rest_name[0] = (char)0;
+    
+    num_jobs = (jobs > 0) ? jobs : 1;
+    num_test = 0;
+    max_test = 0;
+    p_test   = NULL;
+    wall_s   = 0.0;
+    next_test.store(0);
+}
+
+// Destructor
+JiveBatch::~JiveBatch()
+{
+    delete [] p_test;
+}
+
+/******************************************************************************/
+/** Load the tests list, one test per line :                                 **/
+/**   <srec> <syms> <trc> [<sigref>]                                         **/
+/** (<srec> : S-Record, Intel HEX or ELF, "-" : no symbols, "#" : comment)  **/
+/**   name : manifest file name                                              **/
+/** Returns the number of tests or -1                                        **/
+/******************************************************************************/
+int JiveBatch::loadManifest(const char *name)
+{
+    FILE *fh;
+    char line[1024];
+    
+    fh = fopen(name, "r");
+    if (!fh)
+    {
+        printf("Cannot open manifest \"%s\" !\n", name);
+        return -1;
+    }
+    
+    while (fgets(line, sizeof(line), fh))
+    {
+        char *tok[4];
+        char *save;
+        char *p;
+        int   num;
+        jive_test_t *test;
+        
+        // Split the line into tokens
+        num = 0;
+        p = strtok_r(line, " \t\r\n", &save);
+        while ((p) && (num < 4))
+        {
+            tok[num++] = p;
+            p = strtok_r(NULL, " \t\r\n", &save);
+        }
+        if ((!num) || (tok[0][0] == '#')) continue;
+        if (num < 3)
+        {
+            printf("Manifest \"%s\" : test \"%s\" ignored (<srec> <syms> <trc> [<sigref>])\n", name, tok[0]);
+            continue;
+        }
+        
+        if (num_test == max_test)
+        {
+            jive_test_t *p_tmp;
+            
+            max_test = (max_test) ? max_test * 2 : 64;
+            p_tmp = new jive_test_t[max_test];
+            if (num_test) memcpy(p_tmp, p_test, num_test * sizeof(jive_test_t));
+            delete [] p_test;
+            p_test = p_tmp;
+        }
+        
+        test = &p_test[num_test++];
+        memset((void *)test, 0, sizeof(jive_test_t));
+        strncpy(test->srec_name, tok[0], 255);
+        if (strcmp(tok[1], "-")) strncpy(test->syms_name, tok[1], 255);
+        strncpy(test->trc_name,  tok[2], 255);
+        if (num > 3) strncpy(test->sig_name, tok[3], 255);
+        test->exit_code = JIVE_EXIT_NOT_RUN;
+    }
+    fclose(fh);
+    
+    return num_test;
+}
+
+/******************************************************************************/
+/** Configuration and RAM contents of one test                               **/
+/**   test     : test from the manifest                                      **/
+/**   cfg_p    : configuration built from the common one                     **/
+/**   ram_init : 64KB RAM contents                                           **/
+/******************************************************************************/
+int JiveBatch::load_test(const jive_test_t *test, jive_cfg_t *cfg_p, vluint8_t *ram_init)
+{
+    mem_region_t reg = { 0x80000000, 0x10000, ram_init, 0 };
+    SymTable *syms;
+    int err;
+    
+    memcpy((void *)cfg_p, (const void *)&cfg, sizeof(cfg));
+    
+    // ELF (RAM and symbols), S-Record or Intel HEX file into SPRAM
+    syms = new SymTable();
+    memset((void *)ram_init, 0, 0x10000);
+    if (is_elf(test->srec_name))
+    {
+        err = read_elf(test->srec_name, &reg, 1, syms, NULL);
+    }
+    else
+    {
+        err = read_image(test->srec_name, &reg, 1, NULL);
+    }
+    if (err)
+    {
+        delete syms;
+        return -1;
+    }
+    
+    // Signature location
+    cfg_p->sig_beg = (vluint32_t)0;
+    cfg_p->sig_end = (vluint32_t)0;
+    if ((test->syms_name[0]) && (syms->loadSyms(test->syms_name)))
+    {
+        printf("Cannot open \"%s\" !\n", test->syms_name);
+    }
+    syms->find("begin_signature", &cfg_p->sig_beg);
+    syms->find("end_signature", &cfg_p->sig_end);
+    // Released by the worker at the end of the test
+    cfg_p->syms = syms;
+    
+    // Outputs named after the trace
+    strcpy(cfg_p->trc_name, test->trc_name);
+    snprintf(cfg_p->uart_name, sizeof(cfg_p->uart_name), "%s_uart_tx.log", test->trc_name);
+    snprintf(cfg_p->vcd_name,  sizeof(cfg_p->vcd_name),  "%s.vcd", test->trc_name);
+    strcpy(cfg_p->sig_name, test->sig_name);
+    if (cfg_p->prof_name[0])
+    {
+        snprintf(cfg_p->prof_name, sizeof(cfg_p->prof_name), "%s_profile.txt", test->trc_name);
+    }
+    if (cfg_p->cg_name[0])
+    {
+        snprintf(cfg_p->cg_name, sizeof(cfg_p->cg_name), "%s_callgrind.out", test->trc_name);
+    }
+    
+    return 0;
+}
+
+// Worker thread : takes the next test until the manifest is done
+void JiveBatch::worker_loop(void)
+{
+    jive_cfg_t  test_cfg;
+    vluint8_t  *ram_init;
+    JiveSim    *sim;
+    int         idx;
+    
+    ram_init = new vluint8_t[65536];
+    sim = NULL;
+    
+    while ((idx = next_test.fetch_add(1)) < num_test)
+    {
+        jive_test_t *test = &p_test[idx];
+        std::chrono::steady_clock::time_point beg;
+        
+        beg = std::chrono::steady_clock::now();
+        
+        if (load_test(test, &test_cfg, ram_init)) continue;
+        
+        // Model built once, then reset for the following tests
+        if (!sim)
+        {
+            sim = new JiveSim(&test_cfg, ram_init);
+        }
+        else if (sim->reset(&test_cfg, ram_init))
+        {
+            delete test_cfg.syms;
+            continue;
+        }
+        
+        if (!sim->start())
+        {
+            while (sim->runCycles(JIVE_LOOP_CYCLES));
+            test->exit_code = sim->finish();
+        }
+        delete test_cfg.syms;
+        test->sim_ps = sim->getTimeStampPs();
+        test->wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+        
+        printf("\n[%d/%d] %s : %s (%llu us, %.3f s)\n", idx + 1, num_test, test->trc_name,
+               get_result_str(test->exit_code),
+               (unsigned long long)(test->sim_ps / (vluint64_t)1000000), test->wall_s);
+    }
+    
+    if (sim) delete sim;
+    
+    delete [] ram_init;
+}
+
+/******************************************************************************/
+/** Run all the tests on the worker threads                                  **/
+/** Returns the number of tests that did not pass                            **/
+/******************************************************************************/
+int JiveBatch::run(void)
+{
+    std::chrono::steady_clock::time_point beg;
+    std::thread **workers;
+    int jobs;
+    int num_fail;
+    
+    beg = std::chrono::steady_clock::now();
+    
+    jobs = (num_jobs < num_test) ? num_jobs : num_test;
+    printf("Running %d tests on %d worker threads\n", num_test, jobs);
+    
+    next_test.store(0);
+    workers = new std::thread *[(jobs) ? jobs : 1];
+    for (int i = 0; i < jobs; i++)
+    {
+        workers[i] = new std::thread(&JiveBatch::worker_loop, this);
+    }
+    for (int i = 0; i < jobs; i++)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+    delete [] workers;
+    
+    wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+    
+    num_fail = 0;
+    for (int i = 0; i < num_test; i++)
+    {
+        if (p_test[i].exit_code != JIVE_EXIT_PASS) num_fail++;
+    }
+    
+    return num_fail;
+}
+
+/******************************************************************************/
+/** Print the results and write them into a summary file :                   **/
+/**   <trc> <result> <simulated ps> <wall s> per test, then the totals       **/
+/**   name : summary file name                                               **/
+/******************************************************************************/
+int JiveBatch::writeSummary(const char *name)
+{
+    FILE *fh;
+    int num_pass;
+    vluint64_t sim_ps;
+    double test_s;
+    
+    fh = fopen(name, "w");
+    if (!fh)
+    {
+        printf("Cannot create summary \"%s\" !\n", name);
+    }
+    
+    printf("\n%-40s %-10s %16s %10s\n", "Test", "Result", "Simulated (ps)", "Wall (s)");
+    if (fh) fprintf(fh, "# test result sim_ps wall_s\n");
+    
+    num_pass = 0;
+    sim_ps   = (vluint64_t)0;
+    test_s   = 0.0;
+    for (int i = 0; i < num_test; i++)
+    {
+        jive_test_t *test = &p_test[i];
+        
+        printf("%-40s %-10s %16llu %10.3f\n", test->trc_name, get_result_str(test->exit_code),
+               (unsigned long long)test->sim_ps, test->wall_s);
+        if (fh)
+        {
+            fprintf(fh, "%s %s %llu %.3f\n", test->trc_name, get_result_str(test->exit_code),
+                    (unsigned long long)test->sim_ps, test->wall_s);
+        }
+        if (test->exit_code == JIVE_EXIT_PASS) num_pass++;
+        sim_ps += test->sim_ps;
+        test_s += test->wall_s;
+    }
+    
+    printf("\n%d tests : %d passed, %d failed\n", num_test, num_pass, num_test - num_pass);
+    printf("Simulated : %llu ps, tests : %.3f s, wall : %.3f s (%d jobs)\n",
+           (unsigned long long)sim_ps, test_s, wall_s, num_jobs);
+    if (fh)
+    {
+        fprintf(fh, "# %d tests %d passed %d failed, %llu ps, %.3f s (%d jobs)\n",
+                num_test, num_pass, num_test - num_pass, (unsigned long long)sim_ps, wall_s, num_jobs);
+        fclose(fh);
+    }
+    
+    return (fh) ? 0 : -1;
+}
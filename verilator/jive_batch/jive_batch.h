@@ -0,0 +1,56 @@
+#ifndef _JIVE_BATCH_H_
+#define _JIVE_BATCH_H_
+
+#include "verilated.h"
+#include "../jive_sim/jive_sim.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <atomic>
+
+// Test result not available yet
+#define JIVE_EXIT_NOT_RUN     (-1)
+
+// One test of the manifest, with its result
+typedef struct
+{
+    // Input files (syms_name, sig_name : empty if none)
+    char       srec_name[256];
+    char       syms_name[256];
+    char       trc_name[256];
+    char       sig_name[256];
+    // Result : JIVE_EXIT_xxx code, simulated time (in ps) and wall time (in s)
+    int        exit_code;
+    vluint64_t sim_ps;
+    double     wall_s;
+} jive_test_t;
+
+// Regression / compliance runner : tests of a manifest shared by worker threads,
+// each of them reusing one JiveSim instance (reset between two tests)
+class JiveBatch
+{
+    public:
+        // Constructor and destructor
+        JiveBatch(const jive_cfg_t *cfg, int num_jobs);
+        ~JiveBatch();
+        // Methods
+        int         loadManifest(const char *name);
+        int         run(void);
+        int         writeSummary(const char *name);
+    private:
+        void        worker_loop(void);
+        int         load_test(const jive_test_t *test, jive_cfg_t *cfg, vluint8_t *ram_init);
+        // Configuration common to all the tests
+        jive_cfg_t  cfg;
+        // Number of worker threads
+        int         num_jobs;
+        // Tests from the manifest
+        int         num_test;
+        int         max_test;
+        jive_test_t *p_test;
+        // Next test to run
+        std::atomic<int> next_test;
+        // Whole run wall time (in s)
+        double      wall_s;
+};
+
+#endif /* _JIVE_BATCH_H_ */
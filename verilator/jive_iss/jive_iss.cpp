@@ -0,0 +1,280 @@
+#include "verilated.h"
+#include "../riscv_trace/riscv_trace.h"
+#include "../riscv_sim/riscv_sim.h"
+#include "../sym_table/sym_table.h"
+#include "../mem_load/mem_load.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctime>
+
+// Period for a 100 MHz clock
+#define PERIOD_100MHz_ps      ((vluint64_t)10000)
+
+// 64KB RAM block and 1KB boot ROM initialization
+static vluint8_t ram_blk_init[65536];
+static vluint8_t rom_blk_init[1024];
+
+// "+<name><value>" parameter : returns <value> or NULL
+static const char *plus_arg(int argc, char **argv, const char *name)
+{
+    int len = strlen(name);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((argv[i][0] == '+') && (!strncmp(argv[i] + 1, name, len)))
+        {
+            return argv[i] + 1 + len;
+        }
+    }
+    return NULL;
+}
+
+// Start address of an image inside one of its loaded regions (image entry point)
+static bool entry_loaded(const mem_region_t *reg, int num, vluint32_t entry)
+{
+    for (int i = 0; i < num; i++)
+    {
+        if ((reg[i].used) && (entry - reg[i].offs < reg[i].size)) return true;
+    }
+    return false;
+}
+
+// Standalone RISC-V simulator : same parameters as the Verilator testbench
+int main(int argc, char **argv)
+{
+    // Simulation duration
+    clock_t beg, end;
+    double secs;
+    // File name generation
+    char file_name[256];
+    char trc_name[256];
+    char sig_name[256];
+    int exit_code;
+    // Program symbols
+    SymTable *syms;
+    // RISC-V ISS and SoC model
+    RISCVTrace *trc;
+    RISCVSim *sim;
+    // Simulation steps
+    vluint64_t max_step;
+    vluint64_t cycles;
+    vluint64_t inst;
+    vluint32_t cpi;
+    bool step_mode;
+    // Testbench configuration
+    const char *arg;
+    // Signature location
+    vluint32_t sig_beg, sig_end;
+    // Memory regions of the image files
+    mem_region_t reg[2];
+    // Reset vector : image entry point, boot ROM (+boot) or RAM
+    vluint32_t reset_pc;
+
+    beg = clock();
+
+    // Default : 1 msec
+    max_step = (vluint64_t)1000000000;
+
+    // Simulation duration : +usec=<num>
+    arg = plus_arg(argc, argv, "usec=");
+    if ((arg) && (arg[0]))
+    {
+        max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000;
+    }
+
+    // Simulation duration : +msec=<num>
+    arg = plus_arg(argc, argv, "msec=");
+    if ((arg) && (arg[0]))
+    {
+        max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000000;
+    }
+
+    // Clock cycles per instruction : +cpi=<num>
+    arg = plus_arg(argc, argv, "cpi=");
+    cpi = ((arg) && (atoi(arg) > 0)) ? (vluint32_t)atoi(arg) : (vluint32_t)16;
+
+    // Instruction by instruction simulation : +step
+    step_mode = (plus_arg(argc, argv, "step") != NULL);
+
+    sim = new RISCVSim();
+    reset_pc = 0x80000000;
+
+    // Boot ROM @ 0x00000000 and RAM @ 0x80000000
+    reg[0].offs = 0x80000000;
+    reg[0].size = sizeof(ram_blk_init);
+    reg[0].ptr  = ram_blk_init;
+    reg[1].offs = 0x00000000;
+    reg[1].size = sizeof(rom_blk_init);
+    reg[1].ptr  = rom_blk_init;
+
+    // S-Record or Intel HEX file input for ROM / RAM initialization
+    arg = plus_arg(argc, argv, "srec=");
+    if ((arg) && (arg[0]))
+    {
+        vluint32_t entry = 0;
+
+        strncpy(file_name, arg, 255);
+        file_name[255] = (char)0;
+        memset((void *)ram_blk_init, 0, sizeof(ram_blk_init));
+        memset((void *)rom_blk_init, 0, sizeof(rom_blk_init));
+        reg[0].used = 0;
+        reg[1].used = 0;
+        if (!read_image(file_name, reg, 2, &entry))
+        {
+            printf("Use file \"%s\" to initialize SPRAM (start address %08X)\n", file_name, entry);
+            if (reg[0].used) sim->loadRam(ram_blk_init);
+            if (reg[1].used) sim->loadRom(rom_blk_init);
+            if (entry_loaded(reg, 2, entry)) reset_pc = entry;
+        }
+    }
+
+    syms = new SymTable();
+    sig_beg = (vluint32_t)0;
+    sig_end = (vluint32_t)0;
+
+    // ELF file input for ROM / RAM initialization and symbols
+    arg = plus_arg(argc, argv, "elf=");
+    if ((arg) && (arg[0]))
+    {
+        vluint32_t entry = 0;
+
+        strncpy(file_name, arg, 255);
+        file_name[255] = (char)0;
+        memset((void *)ram_blk_init, 0, sizeof(ram_blk_init));
+        memset((void *)rom_blk_init, 0, sizeof(rom_blk_init));
+        reg[0].used = 0;
+        reg[1].used = 0;
+        if (!read_elf(file_name, reg, 2, syms, &entry))
+        {
+            printf("Use file \"%s\" to initialize SPRAM (start address %08X, %d symbols)\n",
+                   file_name, entry, syms->count());
+            if (reg[0].used) sim->loadRam(ram_blk_init);
+            if (reg[1].used) sim->loadRom(rom_blk_init);
+            if (entry_loaded(reg, 2, entry)) reset_pc = entry;
+        }
+    }
+
+    // Start in the boot ROM instead of the RAM / image entry point : +boot
+    if (plus_arg(argc, argv, "boot"))
+    {
+        reset_pc = 0x00000000;
+    }
+    printf("Reset vector : %08X\n", reset_pc);
+
+    // Symbols file input for signature location
+    arg = plus_arg(argc, argv, "syms=");
+    if ((arg) && (arg[0]))
+    {
+        strncpy(file_name, arg, 255);
+        file_name[255] = (char)0;
+        if (!syms->loadSyms(file_name))
+        {
+            printf("Use file \"%s\" for signature location\n", file_name);
+        }
+    }
+    if (!syms->find("begin_signature", &sig_beg))
+    {
+        printf("%s = %08X\n", "begin_signature", sig_beg);
+    }
+    if (!syms->find("end_signature", &sig_end))
+    {
+        printf("%s = %08X\n", "end_signature", sig_end);
+    }
+
+    arg = plus_arg(argc, argv, "trc=");
+    if ((arg) && (arg[0]))
+    {
+        strncpy(trc_name, arg, 255);
+        trc_name[255] = (char)0;
+    }
+    else
+    {
+        strcpy(trc_name, "riscv");
+    }
+
+    // Reference signature, compared at the end of the test : +sigref=<name>
+    arg = plus_arg(argc, argv, "sigref=");
+    if ((arg) && (arg[0]))
+    {
+        strncpy(sig_name, arg, 255);
+        sig_name[255] = (char)0;
+    }
+    else
+    {
+        sig_name[0] = (char)0;
+    }
+
+    // Initialize RISC-V ISS (signature only, no trace)
+    trc = new RISCVTrace(reset_pc, sig_beg, sig_end);
+    trc->openSignature(trc_name);
+    sim->openUart("uart_tx.log");
+
+    // Simulation loop
+    cycles = (vluint64_t)0;
+    inst   = (vluint64_t)0;
+    if (step_mode)
+    {
+        // One instruction at a time
+        while (cycles * PERIOD_100MHz_ps < max_step)
+        {
+            inst++;
+            if (trc->step(sim, sim->timerInt()))
+            {
+                printf("Dead loop reached after %llu instructions\n", inst);
+                break;
+            }
+            sim->advance(cpi);
+            cycles += (vluint64_t)cpi;
+        }
+    }
+    else
+    {
+        // Translated blocks (timer checked between blocks)
+        while (cycles * PERIOD_100MHz_ps < max_step)
+        {
+            vluint32_t n;
+            bool dead;
+            
+            n = trc->run(sim, sim->timerInt(), (vluint32_t)256, &dead, BLK_NO_STOP);
+            if (!n) n = (vluint32_t)1;
+            inst += (vluint64_t)n;
+            sim->advance(n * cpi);
+            cycles += (vluint64_t)(n * cpi);
+            if (dead)
+            {
+                printf("Dead loop reached after %llu instructions\n", inst);
+                break;
+            }
+        }
+    }
+
+    trc->close();
+
+    exit_code = 0;
+    if (sig_name[0])
+    {
+        if (trc->compareSignature(sig_name))
+        {
+            printf("Signature : FAIL (\"%s\")\n", sig_name);
+            exit_code = 2;
+        }
+        else
+        {
+            printf("Signature : PASS\n");
+        }
+    }
+
+    delete trc;
+
+    delete sim;
+
+    delete syms;
+
+    // Calculate running time
+    end = clock();
+    secs = (double)(end - beg) / CLOCKS_PER_SEC;
+    printf("\nSeconds elapsed : %f (%.2f MIPS)\n", secs, (secs > 0.0) ? (double)inst / secs / 1e6 : 0.0);
+
+    return exit_code;
+}
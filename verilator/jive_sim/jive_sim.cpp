@@ -0,0 +1,1133 @@
+#include "Vjive_soc_top.h"
+#include "Vjive_soc_top__Dpi.h"
+#include "verilated.h"
+#include "verilated_save.h"
+#include "verilated_syms.h"
+#include "jive_sim.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <mutex>
+
+// Key of the JiveSim instance in the DPI scopes user data
+static int dpi_key;
+
+// Memories of the SoC instances : the SPRAM and EBR models keep an index
+// (slot * 2 + half) instead of a scope, no scope lookup on each access
+static jive_mem_t *mem_table[JIVE_MEM_SLOTS];
+static std::mutex  mem_lock;
+
+// 100 MHz clock edge : clock input of the Verilated model
+static void clk_edge(void *user, int clk_idx, vluint8_t state)
+{
+    ((Vjive_soc_top *)user)->clk = state & 1;
+}
+
+// Least common multiple of two periods (in clock cycles)
+static vluint64_t lcm_cycles(vluint64_t a, vluint64_t b)
+{
+    vluint64_t x = a, y = b;
+    
+    while (y)
+    {
+        vluint64_t t = x % y;
+        x = y;
+        y = t;
+    }
+    return (a / x) * b;
+}
+
+// Constructor
+JiveSim::JiveSim(const jive_cfg_t *cfg_p, const vluint8_t *ram_init)
+{
+    const VerilatedScopeNameMap *scopes;
+    
+    memcpy((void *)&cfg, (const void *)cfg_p, sizeof(cfg));
+    
+    // RAM and register file of this instance (attached by the first evaluation)
+    mem = new jive_mem_t;
+    memset((void *)mem, 0, sizeof(jive_mem_t));
+    memcpy((void *)mem->ram, (const void *)ram_init, sizeof(mem->ram));
+    mem_lock.lock();
+    for (mem_slot = 0; mem_slot < JIVE_MEM_SLOTS; mem_slot++)
+    {
+        if (!mem_table[mem_slot]) break;
+    }
+    if (mem_slot < JIVE_MEM_SLOTS) mem_table[mem_slot] = mem;
+    mem_lock.unlock();
+    if (mem_slot == JIVE_MEM_SLOTS)
+    {
+        printf("Too many SoC instances (%d max) !\n", JIVE_MEM_SLOTS);
+        exit(EXIT_FAILURE);
+    }
+    
+    // No hand-off
+    hoff_on  = false;
+    
+    // Verilog instance with its own context
+    ctx = new VerilatedContext;
+    top = new Vjive_soc_top(ctx);
+    top->sim_rst = 0;
+
+    // DPI-C calls of this instance : every scope points to the object
+    spram_num = 0;
+    ebr_num   = 0;
+    timer_scope = NULL;
+    lsosc_scope = NULL;
+    csr_scope   = NULL;
+    uart_scope  = NULL;
+    scopes = ctx->scopeNameMap();
+    for (VerilatedScopeNameMap::const_iterator it = scopes->begin(); it != scopes->end(); ++it)
+    {
+        const char *inst = strrchr(it->first, '.');
+        
+        svPutUserData((const svScope)it->second, (void *)&dpi_key, (void *)this);
+        
+        // SPRAM (U_spram_hi, U_spram_lo) and register file (U_reg_file_lo, U_reg_file_hi)
+        inst = (inst) ? inst + 1 : it->first;
+        if ((!strncmp(inst, "U_spram_", 8)) && (spram_num < 2))
+        {
+            spram_scope[spram_num++] = (const svScope)it->second;
+        }
+        if ((!strncmp(inst, "U_reg_file_", 11)) && (ebr_num < 2))
+        {
+            ebr_scope[ebr_num++] = (const svScope)it->second;
+        }
+        // Timer, low frequency oscillator, CSR and UART (idle skip)
+        if (!strcmp(inst, "U_timer"))        timer_scope = (const svScope)it->second;
+        if (!strcmp(inst, "U_low_freq_osc")) lsosc_scope = (const svScope)it->second;
+        if (!strcmp(inst, "U_jive_csr"))     csr_scope   = (const svScope)it->second;
+        if (!strcmp(inst, "U_uart"))         uart_scope  = (const svScope)it->second;
+    }
+    
+    init_test();
+}
+
+// Destructor
+JiveSim::~JiveSim()
+{
+    free_test();
+    
+    top->final();
+    
+    delete top;
+    
+    delete ctx;
+    
+    mem_lock.lock();
+    mem_table[mem_slot] = NULL;
+    mem_lock.unlock();
+    delete mem;
+}
+
+// Clocks, trace and outputs of the current test (configuration in cfg)
+void JiveSim::init_test(void)
+{
+    // No outputs yet
+    uart_fh  = NULL;
+    ffwd_sim = NULL;
+    prof     = NULL;
+    // No UART input yet, idle line
+    uart_in_buf   = NULL;
+    uart_in_len   = 0;
+    uart_in_pos   = 0;
+    uart_in_bit   = -1;
+    uart_in_cnt   = 0;
+    uart_in_frame = 0;
+    top->uart_rxd = 1;
+#if VM_TRACE
+    tfp = NULL;
+#endif /* VM_TRACE */
+
+    // Initialize clock generator
+    clk = new ClockGen(1, cfg.max_step);
+    // 100 MHz clock
+    clk->NewClock(0, PERIOD_100MHz_ps, 0);
+    clk->StartClock(0);
+    clk->SetEdgeCallback(0, CLK_EDGE_BOTH, clk_edge, (void *)top);
+    top->clk = clk->GetClockStateDiv1(0,0);
+    
+    // Initialize RISC-V trace (reset vector : boot ROM or RAM)
+    trc = new RISCVTrace((cfg.boot_rom) ? 0x00000000 : 0x80000000, cfg.sig_beg, cfg.sig_end);
+    trc->setFormat(cfg.trc_fmt);
+    trc->setTrigger(TRG_START, cfg.trg_type[TRG_START], cfg.trg_value[TRG_START]);
+    trc->setTrigger(TRG_STOP,  cfg.trg_type[TRG_STOP],  cfg.trg_value[TRG_STOP]);
+    trc->setHistory(cfg.trc_hist);
+    trc->setSegmentSize(cfg.trc_seg);
+    trc->setCompression(cfg.trc_gz);
+    trc->setSymbols(cfg.syms);
+    if ((cfg.prof_name[0]) || (cfg.cg_name[0]))
+    {
+        prof = new Profiler(PERIOD_100MHz_ps);
+        trc->setProfiler(prof);
+    }
+    fail_name[0] = (char)0;
+    if (cfg.fail_depth)
+    {
+        snprintf(fail_name, sizeof(fail_name), "%s_mismatch.json", cfg.trc_name);
+        trc->setFailFast(fail_name, cfg.fail_depth);
+    }
+    
+    idle_reset();
+}
+
+// Release the clocks, trace and outputs of the current test
+void JiveSim::free_test(void)
+{
+#if VM_TRACE
+    if (tfp) delete tfp;
+#endif /* VM_TRACE */
+
+    delete trc;
+    
+    if (prof) delete prof;
+    
+    if (ffwd_sim) delete ffwd_sim;
+    
+    if (uart_fh) fclose(uart_fh);
+    
+    if (uart_in_buf) delete [] uart_in_buf;
+    
+    delete clk;
+}
+
+/******************************************************************************/
+/** Reuse the Verilog model for another test instead of building a new one : **/
+/** the SoC is reset through sim_rst, the SPRAM and the register file are    **/
+/** loaded again, then the clocks, trace and outputs follow the new cfg      **/
+/** (to be called after finish(), +ffwd / +save / +restore are not kept)     **/
+/**   cfg_p    : configuration of the new test                               **/
+/**   ram_init : 64KB RAM contents of the new test                           **/
+/******************************************************************************/
+int JiveSim::reset(const jive_cfg_t *cfg_p, const vluint8_t *ram_init)
+{
+    // One rising edge with sim_rst : reset counter cleared, whole SoC under reset
+    top->sim_rst = 1;
+    top->clk = 0;
+    top->eval();
+    top->clk = 1;
+    top->eval();
+    top->clk = 0;
+    top->eval();
+    top->sim_rst = 0;
+    
+    free_test();
+    
+    memcpy((void *)&cfg, (const void *)cfg_p, sizeof(cfg));
+    memcpy((void *)mem->ram, (const void *)ram_init, sizeof(mem->ram));
+    cfg.ffwd_type    = TRG_NONE;
+    cfg.save_name[0] = (char)0;
+    cfg.rest_name[0] = (char)0;
+    hoff_on = false;
+    
+    // Register file back to its initial contents (exported by EBR_B.v)
+    if ((spram_num != 2) || (ebr_num != 2))
+    {
+        printf("Memory models not found (%d SPRAM, %d EBR) !\n", spram_num, ebr_num);
+        init_test();
+        return -1;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        svSetScope(ebr_scope[i]);
+        ebr_reload();
+    }
+    
+    ctx->gotFinish(false);
+    
+    init_test();
+    
+    return 0;
+}
+
+// Open the outputs, restore a checkpoint or fast-forward (before the first evaluation)
+int JiveSim::start(void)
+{
+    // UART input (position restored with the checkpoint)
+    if ((cfg.uart_in[0]) && (uart_load(cfg.uart_in)))
+    {
+        printf("File %s open error\n", cfg.uart_in);
+    }
+    
+    if (cfg.rest_name[0])
+    {
+        // Verilog model, clocks and ISS from the checkpoint (trace files included)
+        if (restore_checkpoint(cfg.rest_name))
+        {
+            printf("Cannot restart from checkpoint \"%s\" !\n", cfg.rest_name);
+            return -1;
+        }
+        cfg.ffwd_type = TRG_NONE;
+    }
+    else
+    {
+        trc->open(cfg.trc_name);
+        uart_fh = fopen(cfg.uart_name, "wb");
+    }
+    if (!uart_fh)
+    {
+        printf("File %s open error\n", cfg.uart_name);
+    }
+    if (cfg.trc_ring)
+    {
+        printf("Lockstep checking in a worker thread (%u samples ring)\n", cfg.trc_ring);
+        trc->startWorker(cfg.trc_ring);
+    }
+    if ((cfg.idle_skip) && ((!timer_scope) || (!lsosc_scope) || (!csr_scope) || (!uart_scope)))
+    {
+        printf("Idle skip disabled : timer, LSOSC, CSR or UART model not found !\n");
+        cfg.idle_skip = 0;
+    }
+
+#if VM_TRACE
+    // Initialize VCD trace dump
+    if (cfg.vcd_name[0])
+    {
+        ctx->traceEverOn(true);
+        tfp = new VerilatedVcdC;
+        top->trace (tfp, 99);
+        tfp->spTrace()->set_time_resolution ("1 ps");
+        tfp->open (cfg.vcd_name);
+    }
+#endif /* VM_TRACE */
+
+    // ISS fast-forward (before the initial blocks are evaluated)
+    if (cfg.ffwd_type != TRG_NONE)
+    {
+        ffwd_sim = new RISCVSim();
+        ffwd_sim->openUart(cfg.ffwd_uart);
+        fast_forward();
+    }
+    
+    // First evaluation at 0 ps (initial blocks), a restored model waits for the next edge
+    if (!cfg.rest_name[0])
+    {
+        eval_step();
+    }
+    
+    return 0;
+}
+
+// Advance the clocks by one step (returns false when the simulation is over)
+bool JiveSim::step(void)
+{
+    if (clk->EndOfSimulation()) return false;
+    
+    // Next clock edge(s) : the callbacks update the clock inputs
+    if (!clk->AdvanceClocks()) return true;
+    
+    // UART input before the rising edges
+    if ((uart_in_buf) && (top->clk)) uart_feed();
+    
+    eval_step();
+    
+    return keep_running();
+}
+
+/******************************************************************************/
+/** Cycle stepping with only the 100 MHz clock running : rising and falling  **/
+/** edges back to back, one trace sample per cycle (the model has no logic   **/
+/** on the falling edge, it is evaluated for the clock edge detection)       **/
+/**   num      : clock cycles or instruction fetches to run                  **/
+/**   to_fetch : count the instruction fetches (i_rd_ack) instead of cycles  **/
+/** Returns false when the simulation is over                                **/
+/******************************************************************************/
+bool JiveSim::run_cycles(vluint64_t num, bool to_fetch)
+{
+    // Several clocks running or falling edge next : edge by edge
+    if ((!clk->SingleClock(0)) || (top->clk))
+    {
+        return step();
+    }
+    
+    while (num)
+    {
+        if (clk->EndOfSimulation()) return false;
+        
+        // UART input, then rising edge : evaluation and trace sample
+        if (uart_in_buf) uart_feed();
+        top->clk = clk->AdvanceEdge(0) & 1;
+        top->eval ();
+        trc->sample (clk->GetTimeStampPs(),
+                     top->i_rd_ack,  top->i_address, top->i_rddata,
+                     top->d_rd_ack,  top->d_wr_ack,  top->d_address,
+                     top->d_byteena, top->d_rddata,  top->d_wrdata,
+                     0,
+                     top->wb_ena,    top->wb_idx,    top->wb_data);
+        if ((!to_fetch) || (top->i_rd_ack)) num--;
+#if VM_TRACE
+        if (tfp) tfp->dump (clk->GetTimeStampPs());
+#endif /* VM_TRACE */
+
+        // Falling edge : evaluation only
+        top->clk = clk->AdvanceEdge(0) & 1;
+        top->eval ();
+#if VM_TRACE
+        if (tfp) tfp->dump (clk->GetTimeStampPs());
+#endif /* VM_TRACE */
+
+        // Steady loop or bus stall : jump to the next event
+        if (cfg.idle_skip) idle_sample();
+
+        if (!keep_running()) return false;
+    }
+    
+    return true;
+}
+
+// Run <num> clock cycles (returns false when the simulation is over)
+bool JiveSim::runCycles(vluint64_t num)
+{
+    return run_cycles(num, false);
+}
+
+// Run up to the <num>th next instruction fetch (returns false when the simulation is over)
+bool JiveSim::runInstr(vluint64_t num)
+{
+    return run_cycles(num, true);
+}
+
+// Checkpoint and end of simulation conditions after an evaluation
+// (returns false when the simulation is over)
+bool JiveSim::keep_running(void)
+{
+    // Simulation checkpoint (once)
+    if ((cfg.save_name[0]) && (clk->GetTimeStampPs() >= cfg.save_ps))
+    {
+        save_checkpoint(cfg.save_name);
+        cfg.save_name[0] = (char)0;
+    }
+    
+    if (ctx->gotFinish()) return false;
+    
+    // First lockstep mismatch (fail-fast)
+    if ((cfg.fail_depth) && (trc->failed())) return false;
+    
+    // End of the compliance test : jump to itself
+    if ((cfg.sig_name[0]) && (trc->halted())) return false;
+    
+    return true;
+}
+
+// Idle skip : no loop head, nothing skipped yet
+void JiveSim::idle_reset(void)
+{
+    idle_head        = IDLE_NO_HEAD;
+    idle_last        = 0;
+    idle_hash        = 0;
+    idle_cycles      = 0;
+    idle_inst        = 0;
+    idle_clean       = false;
+    idle_prev_hash   = 0;
+    idle_prev_cycles = 0;
+    idle_match       = 0;
+    idle_miss        = 0;
+    idle_quiet       = 0;
+    idle_skipped     = 0;
+    idle_jumps       = 0;
+}
+
+/******************************************************************************/
+/** Idle skip, loop detection (once per clock cycle) : an iteration starts    **/
+/** at a loop head (target of a backward jump), its fetches, reads and        **/
+/** writebacks are hashed with their cycle position. Identical iterations    **/
+/** without bus write nor timer read, or a bus stall, can be jumped over     **/
+/******************************************************************************/
+void JiveSim::idle_sample(void)
+{
+    vluint64_t h;
+    
+    // No bus nor writeback activity : CPU waiting for a bus acknowledge
+    if (!(top->i_rd_ack | top->d_rd_ack | top->d_wr_ack | top->wb_ena))
+    {
+        idle_cycles++;
+        if ((++idle_quiet & (IDLE_STALL_CYCLES - 1)) == 0) idle_jump(1, 0);
+        return;
+    }
+    idle_quiet = 0;
+    
+    if (top->i_rd_ack)
+    {
+        if (top->i_address == idle_head)
+        {
+            // End of an iteration : same as the previous one ?
+            if ((idle_clean) && (idle_hash == idle_prev_hash) && (idle_cycles == idle_prev_cycles))
+            {
+                idle_miss = 0;
+                if (++idle_match >= IDLE_MATCH_ITER) idle_jump(idle_cycles, idle_inst);
+            }
+            else
+            {
+                idle_match = 0;
+                idle_miss++;
+            }
+            idle_prev_hash   = idle_hash;
+            idle_prev_cycles = idle_cycles;
+            idle_cycles      = 0;
+        }
+        else if ((top->i_address <= idle_last) &&
+                 ((idle_head == IDLE_NO_HEAD) || (idle_miss >= IDLE_MAX_MISS) || (idle_cycles > IDLE_MAX_CYCLES)))
+        {
+            // Backward jump : new loop head
+            idle_head        = top->i_address;
+            idle_prev_hash   = 0;
+            idle_prev_cycles = 0;
+            idle_match       = 0;
+            idle_miss        = 0;
+            idle_cycles      = 0;
+        }
+        if (!idle_cycles)
+        {
+            idle_hash  = (vluint64_t)0xCBF29CE484222325ULL;
+            idle_inst  = 0;
+            idle_clean = true;
+        }
+        idle_last = top->i_address;
+        idle_inst++;
+    }
+    
+    // Bus writes and timer reads (mtime changes) : iteration not skipped
+    if ((top->d_wr_ack) || ((top->d_rd_ack) && ((top->d_address & 0x80030000) == 0x00010000)))
+    {
+        idle_clean = false;
+    }
+    
+    // Activity hash (FNV-1a on 32-bit words)
+    h = idle_hash;
+    h = (h ^ idle_cycles) * (vluint64_t)0x100000001B3ULL;
+    if (top->i_rd_ack)
+    {
+        h = (h ^ top->i_address) * (vluint64_t)0x100000001B3ULL;
+        h = (h ^ top->i_rddata)  * (vluint64_t)0x100000001B3ULL;
+    }
+    if (top->d_rd_ack)
+    {
+        h = (h ^ top->d_address) * (vluint64_t)0x100000001B3ULL;
+        h = (h ^ top->d_rddata)  * (vluint64_t)0x100000001B3ULL;
+    }
+    if (top->wb_ena)
+    {
+        h = (h ^ top->wb_idx)    * (vluint64_t)0x100000001B3ULL;
+        h = (h ^ top->wb_data)   * (vluint64_t)0x100000001B3ULL;
+    }
+    idle_hash = h;
+    idle_cycles++;
+}
+
+/******************************************************************************/
+/** Idle skip, time skip : jump over whole iterations up to the next event   **/
+/** (timer interrupt, checkpoint, end of the simulation). The skipped time   **/
+/** is a multiple of the LSOSC and UART baud rate periods so these counters  **/
+/** stay in phase, mtime and mcycle are moved forward by the DPI-C exports   **/
+/**   period : clock cycles of one iteration (1 : bus stall)                 **/
+/**   inst   : instructions fetched in one iteration                         **/
+/******************************************************************************/
+void JiveSim::idle_jump(vluint64_t period, vluint64_t inst)
+{
+    vluint64_t grain, num, now, edges, cycles;
+    
+    grain = lcm_cycles(lcm_cycles(period, IDLE_LSOSC_CYCLES), UART_BAUD_CYCLES);
+    if (grain > IDLE_MAX_GRAIN) return;
+    
+    // UART sending or receiving a byte, next input byte (on the line or waiting for an empty holding register)
+    svSetScope(uart_scope);
+    if (!uart_idle()) return;
+    if ((uart_in_bit >= 0) || ((uart_in_pos < uart_in_len) && (!uart_rx_full()))) return;
+    
+    // End of the simulation and checkpoint : simulated again
+    now = clk->GetTimeStampPs();
+    if (now >= cfg.max_step) return;
+    num = (cfg.max_step - now - 1) / PERIOD_100MHz_ps / grain;
+    if (cfg.save_name[0])
+    {
+        if (now >= cfg.save_ps) return;
+        if ((cfg.save_ps - now - 1) / PERIOD_100MHz_ps / grain < num)
+        {
+            num = (cfg.save_ps - now - 1) / PERIOD_100MHz_ps / grain;
+        }
+    }
+    
+    // Timer interrupt (mtime > mtimecmp) : simulated again
+    svSetScope(lsosc_scope);
+    edges = (vluint64_t)lsosc_edges((long long)grain);
+    if (edges)
+    {
+        vluint64_t mtime, mtimecmp;
+        
+        svSetScope(timer_scope);
+        mtime    = (vluint64_t)timer_read(0);
+        mtimecmp = (vluint64_t)timer_read(1);
+        if ((mtime <= mtimecmp) && ((mtimecmp - mtime) / edges < num))
+        {
+            num = (mtimecmp - mtime) / edges;
+        }
+    }
+    if (!num) return;
+    
+    // Clock, LSOSC, mtime and mcycle moved forward
+    cycles = num * grain;
+    clk->SkipCycles(0, cycles);
+    svSetScope(lsosc_scope);
+    lsosc_skip((long long)cycles);
+    if (edges)
+    {
+        svSetScope(timer_scope);
+        timer_skip((long long)(num * edges));
+    }
+    svSetScope(csr_scope);
+    csr_skip((long long)cycles);
+    
+    // ISS : instructions of the skipped iterations
+    trc->skipInstr((cycles / period) * inst);
+    
+    idle_skipped += cycles;
+    idle_jumps++;
+}
+
+// UART input (+uartin) : whole file in memory
+int JiveSim::uart_load(const char *name)
+{
+    FILE *fh;
+    long size;
+    
+    fh = fopen(name, "rb");
+    if (!fh) return -1;
+    
+    fseek(fh, 0, SEEK_END);
+    size = ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+    uart_in_buf = new vluint8_t[(size > 0) ? size : 1];
+    uart_in_len = (size > 0) ? (vluint32_t)fread((void *)uart_in_buf, 1, (size_t)size, fh) : 0;
+    fclose(fh);
+    
+    printf("UART input : %u bytes from \"%s\" (%s)\n", uart_in_len, name,
+           (cfg.uart_fast) ? "holding register" : "8N1 frames");
+    
+    return 0;
+}
+
+/******************************************************************************/
+/** UART input, once per clock cycle before the rising edge : the next byte  **/
+/** goes into the holding register as soon as it is empty (+uartfast), or   **/
+/** is sent bit by bit on uart_rxd (1 start, 8 data, 1 stop bit) once the    **/
+/** previous one has been read (no overrun whatever the CPU speed)           **/
+/******************************************************************************/
+void JiveSim::uart_feed(void)
+{
+    // Current bit still on the line
+    if (uart_in_cnt)
+    {
+        uart_in_cnt--;
+        return;
+    }
+    
+    if (uart_in_bit < 0)
+    {
+        // Whole file sent, previous byte not read yet
+        if (uart_in_pos >= uart_in_len) return;
+        svSetScope(uart_scope);
+        if (uart_rx_full()) return;
+        
+        if (cfg.uart_fast)
+        {
+            uart_rx_put((int)uart_in_buf[uart_in_pos++]);
+            return;
+        }
+        // Stop(1) | Byte | Start(0)
+        uart_in_frame = 0x200 | ((vluint32_t)uart_in_buf[uart_in_pos++] << 1);
+        uart_in_bit   = 0;
+    }
+    
+    top->uart_rxd = (uart_in_frame >> uart_in_bit) & 1;
+    uart_in_cnt   = (vluint32_t)UART_BAUD_CYCLES - 1;
+    if (++uart_in_bit == 10) uart_in_bit = -1;
+}
+
+// Evaluate the Verilated model at the current time stamp, then trace it
+void JiveSim::eval_step(void)
+{
+    // Evaluate verilated model
+    top->eval ();
+    
+    // RISC-V trace
+    trc->dump (clk->GetTimeStampPs(), top->clk,
+               top->i_rd_ack,  top->i_address, top->i_rddata,
+               top->d_rd_ack,  top->d_wr_ack,  top->d_address,
+               top->d_byteena, top->d_rddata,  top->d_wrdata,
+               0,
+               top->wb_ena,    top->wb_idx,    top->wb_data);
+
+#if VM_TRACE
+    // Dump signals into VCD file
+    if (tfp)
+    {
+        tfp->dump (clk->GetTimeStampPs());
+    }
+#endif /* VM_TRACE */
+}
+
+// Close the outputs and check the results (returns the exit code)
+int JiveSim::finish(void)
+{
+    int exit_code;
+
+#if VM_TRACE
+    if (tfp) tfp->close();
+#endif /* VM_TRACE */
+
+    trc->close();
+    
+    if (prof)
+    {
+        prof->stop(clk->GetTimeStampPs());
+        if (cfg.prof_name[0]) prof->writeFlat(cfg.prof_name, cfg.syms);
+        if (cfg.cg_name[0])   prof->writeCallgrind(cfg.cg_name, cfg.syms);
+    }
+    
+    if (idle_jumps)
+    {
+        printf("\nIdle skip : %llu cycles skipped (%llu jumps)\n",
+               (unsigned long long)idle_skipped, (unsigned long long)idle_jumps);
+    }
+    
+    exit_code = JIVE_EXIT_PASS;
+    if ((cfg.fail_depth) && (trc->failed()))
+    {
+        printf("\nLockstep mismatch, see \"%s\"\n", fail_name);
+        exit_code = JIVE_EXIT_MISMATCH;
+    }
+    if (cfg.sig_name[0])
+    {
+        if (trc->compareSignature(cfg.sig_name))
+        {
+            printf("Signature : FAIL (\"%s\")\n", cfg.sig_name);
+            if (!exit_code) exit_code = JIVE_EXIT_SIGNATURE;
+        }
+        else
+        {
+            printf("Signature : PASS\n");
+        }
+    }
+    
+    return exit_code;
+}
+
+// Current simulation time (in ps)
+vluint64_t JiveSim::getTimeStampPs(void)
+{
+    return clk->GetTimeStampPs();
+}
+
+// RAM contents of the running test (read and written in place by SP256K)
+vluint8_t *JiveSim::getRam(void)
+{
+    return mem->ram;
+}
+
+// Register file entry set by the hand-off (32-bit value : LSW, MSW)
+void JiveSim::hoff_set(int index, vluint32_t value)
+{
+    hoff_ebr[index + 0]     = (vluint16_t)(value);
+    hoff_ebr[index + 1]     = (vluint16_t)(value >> 16);
+    hoff_ebr_ena[index + 0] = true;
+    hoff_ebr_ena[index + 1] = true;
+}
+
+/******************************************************************************/
+/** Fast-forward in the ISS up to a PC or an instruction count, then prepare **/
+/** the state handed over to the Verilog model before its first evaluation   **/
+/** (cfg.ffwd_type : TRG_PC or TRG_INSTR, cfg.ffwd_value : PC or count,      **/
+/**  cfg.ffwd_cpi : clock cycles per instruction for the machine timer).     **/
+/** A PC not reached within the simulation time (+usec / +msec) is reported  **/
+/** and the hand-off happens where the ISS stopped.                          **/
+/******************************************************************************/
+void JiveSim::fast_forward(void)
+{
+    // Machine mode CSR kept in the register file :
+    // mstatus, mie, mtvec, mscratch, mepc, mcause, mtval
+    static const int csr_list[7] = { 0x300, 0x304, 0x305, 0x340, 0x341, 0x342, 0x343 };
+    RISCVSim *sim = ffwd_sim;
+    vluint64_t value = cfg.ffwd_value;
+    vluint32_t cpi = cfg.ffwd_cpi;
+    vluint8_t *ram;
+    vluint32_t base, size;
+    vluint32_t mie;
+    vluint64_t isr_end;
+    vluint64_t max_inst;
+    bool dead;
+    
+    sim->loadRam(mem->ram);
+    dead = false;
+    
+    if (cfg.ffwd_type == TRG_INSTR)
+    {
+        // Translated blocks while far enough from the count
+        while ((!dead) && (trc->getInstCount() + BLK_MAX_INS < value))
+        {
+            vluint64_t left = value - trc->getInstCount() - BLK_MAX_INS;
+            vluint32_t n;
+            
+            n = trc->run(sim, sim->timerInt(), (left > 256) ? (vluint32_t)256 : (vluint32_t)left, &dead, BLK_NO_STOP);
+            sim->advance(((n) ? n : 1) * cpi);
+        }
+        // Then one instruction at a time
+        while ((!dead) && (trc->getInstCount() < value))
+        {
+            dead = (trc->step(sim, sim->timerInt()) != 0);
+            sim->advance(cpi);
+        }
+    }
+    else
+    {
+        // At most the instructions of the simulation time (+usec / +msec)
+        max_inst = cfg.max_step / (PERIOD_100MHz_ps * cpi);
+        while ((!dead) && (trc->getPc() != (vluint32_t)value) && (trc->getInstCount() < max_inst))
+        {
+            vluint32_t n;
+            
+            // Translated blocks, one instruction at a time in the block holding the PC
+            n = trc->run(sim, sim->timerInt(), (vluint32_t)256, &dead, (vluint32_t)value);
+            if ((!n) && (!dead) && (trc->getPc() != (vluint32_t)value))
+            {
+                dead = (trc->step(sim, sim->timerInt()) != 0);
+                n = 1;
+            }
+            sim->advance(((n) ? n : 1) * cpi);
+        }
+        if ((!dead) && (trc->getPc() != (vluint32_t)value))
+        {
+            printf("Warning : fast-forward PC %08X not reached after %llu instructions\n",
+                   (vluint32_t)value, (unsigned long long)trc->getInstCount());
+        }
+    }
+    
+    // Interrupts are not nested in the CPU : leave the handler first
+    isr_end = trc->getInstCount() + FFWD_ISR_MAX;
+    while ((!dead) && (trc->inIsr()) && (trc->getInstCount() < isr_end))
+    {
+        dead = (trc->step(sim, sim->timerInt()) != 0);
+        sim->advance(cpi);
+    }
+    if (trc->inIsr())
+    {
+        printf("Warning : hand-off inside an exception / interrupt handler\n");
+    }
+    
+    printf("Fast-forward : %llu instructions, hand-off at PC = %08X%s\n",
+           (unsigned long long)trc->getInstCount(), trc->getPc(), (dead) ? " (dead loop)" : "");
+    
+    // RAM contents (read by SP256K)
+    ram = sim->direct(&base, &size);
+    memcpy((void *)mem->ram, (const void *)ram, size);
+    
+    // Register file (EBR_B initialization) :
+    // x1 - x31 at 0x42 - 0x7F, CSR index <n> at 0x80 + 2 * <n>
+    memset((void *)hoff_ebr_ena, 0, sizeof(hoff_ebr_ena));
+    for (int i = 1; i < 32; i++)
+    {
+        hoff_set(0x40 + (i << 1), trc->getReg(i));
+    }
+    hoff_set(0x80 + (0x07 << 1), trc->getPc());
+    for (int i = 0; i < 7; i++)
+    {
+        int idx = 0x10 | ((csr_list[i] >> 3) & 0x08) | (csr_list[i] & 0x07);
+        
+        hoff_set(0x80 + (idx << 1), trc->getCsr(csr_list[i]));
+    }
+    
+    // Fetch address (jive_alu16.v)
+    hoff_pc  = trc->getPc();
+    // Interrupts enable bits #11, #7, #3 (jive_csr.v)
+    mie      = trc->getCsr(0x304);
+    hoff_mie = ((mie >> 3) & 1) | ((mie >> 6) & 2) | ((mie >> 9) & 4);
+    // mtime, mtimecmp (jive_timer.v)
+    sim->getTimer(&hoff_timer[0], &hoff_timer[1]);
+    
+    hoff_on = true;
+}
+
+/******************************************************************************/
+/** Save the whole simulation into a checkpoint file : Verilog model, clocks **/
+/** generator, ISS state and outputs positions (trace segment, UART log)     **/
+/**   name : checkpoint file name                                            **/
+/******************************************************************************/
+int JiveSim::save_checkpoint(const char *name)
+{
+#if JIVE_SAVABLE
+    VerilatedSave os;
+    long upos;
+    
+    os.open(name);
+    if (!os.isOpen())
+    {
+        printf("Cannot create checkpoint \"%s\" !\n", name);
+        return -1;
+    }
+    
+    os << *top;
+    os.write(mem, sizeof(jive_mem_t));
+    clk->SaveState(os);
+    trc->save(os);
+    
+    upos = -1;
+    if (uart_fh)
+    {
+        fflush(uart_fh);
+        upos = ftell(uart_fh);
+    }
+    os.write(&upos, sizeof(upos));
+    os.write(&uart_in_pos, sizeof(uart_in_pos));
+    os.write(&uart_in_bit, sizeof(uart_in_bit));
+    os.write(&uart_in_cnt, sizeof(uart_in_cnt));
+    os.write(&uart_in_frame, sizeof(uart_in_frame));
+    os.close();
+    
+    printf("\nCheckpoint \"%s\" saved at %llu ps\n", name,
+           (unsigned long long)clk->GetTimeStampPs());
+    
+    return 0;
+#else
+    printf("Checkpoints are disabled (see SAVE_OPT in compile.sh) !\n");
+    return -1;
+#endif /* JIVE_SAVABLE */
+}
+
+/******************************************************************************/
+/** Restore the whole simulation from a checkpoint file (before the first    **/
+/** evaluation of the Verilog model)                                         **/
+/**   name : checkpoint file name                                            **/
+/******************************************************************************/
+int JiveSim::restore_checkpoint(const char *name)
+{
+#if JIVE_SAVABLE
+    VerilatedRestore is;
+    long upos;
+    
+    is.open(name);
+    if (!is.isOpen())
+    {
+        printf("Cannot open checkpoint \"%s\" !\n", name);
+        return -1;
+    }
+    
+    is >> *top;
+    is.read(mem, sizeof(jive_mem_t));
+    if ((clk->RestoreState(is)) || (trc->restore(is)))
+    {
+        is.close();
+        return -1;
+    }
+    
+    // The memory indexes of the models come from the saving process
+    for (int i = 0; i < spram_num; i++)
+    {
+        svSetScope(spram_scope[i]);
+        spram_attach();
+    }
+    for (int i = 0; i < ebr_num; i++)
+    {
+        svSetScope(ebr_scope[i]);
+        ebr_attach();
+    }
+    
+    // UART log truncated to the checkpoint, UART input position
+    is.read(&upos, sizeof(upos));
+    is.read(&uart_in_pos, sizeof(uart_in_pos));
+    is.read(&uart_in_bit, sizeof(uart_in_bit));
+    is.read(&uart_in_cnt, sizeof(uart_in_cnt));
+    is.read(&uart_in_frame, sizeof(uart_in_frame));
+    is.close();
+    if (uart_in_pos > uart_in_len)
+    {
+        uart_in_pos = uart_in_len;
+        uart_in_bit = -1;
+        uart_in_cnt = 0;
+    }
+    uart_fh = (upos >= 0) ? fopen(cfg.uart_name, "r+b") : NULL;
+    if (uart_fh)
+    {
+        if (ftruncate(fileno(uart_fh), (off_t)upos))
+        {
+            printf("Cannot truncate \"%s\" !\n", cfg.uart_name);
+        }
+        fseek(uart_fh, 0, SEEK_END);
+    }
+    else
+    {
+        uart_fh = fopen(cfg.uart_name, "wb");
+    }
+    
+    printf("Checkpoint \"%s\" restored at %llu ps\n", name,
+           (unsigned long long)clk->GetTimeStampPs());
+    
+    return 0;
+#else
+    printf("Checkpoints are disabled (see SAVE_OPT in compile.sh) !\n");
+    return -1;
+#endif /* JIVE_SAVABLE */
+}
+
+// Instruction disassembly for the waveforms
+void JiveSim::dpiDisasm(vluint32_t inst, vluint32_t pc, vluint32_t *text)
+{
+    trc->disasm(inst, pc, text);
+}
+
+// UART output of the Verilog model
+void JiveSim::dpiUartTx(int data)
+{
+    if (uart_fh) fputc(data & 0xFF, uart_fh);
+}
+
+// Register file initialization : INIT_x contents or ISS hand-off
+void JiveSim::dpiEbrInit(int index, int data)
+{
+    int half = ebr_half();
+    
+    if (half < 0) return;
+    
+    if ((hoff_on) && (hoff_ebr_ena[index & 255]))
+    {
+        data = (int)hoff_ebr[index & 255];
+    }
+    mem->ebr[half][index & 255] = (vluint16_t)data;
+}
+
+// Register file index of the calling EBR_B
+int JiveSim::dpiEbrMem(void)
+{
+    int half = ebr_half();
+    
+    return (mem_slot << 1) | ((half < 0) ? 0 : half);
+}
+
+// ISS hand-off or boot ROM : fetch address after reset
+int JiveSim::dpiResetPc(int pc)
+{
+    if (hoff_on) return (int)hoff_pc;
+    
+    return (cfg.boot_rom) ? 0x00000000 : pc;
+}
+
+// ISS hand-off : interrupts enable after reset
+int JiveSim::dpiResetMie(int mie)
+{
+    return (hoff_on) ? (int)hoff_mie : mie;
+}
+
+// ISS hand-off : mtime (index 0) and mtimecmp (index 1) after reset
+long long JiveSim::dpiResetTimer(int index, long long value)
+{
+    return (hoff_on) ? (long long)hoff_timer[index & 1] : value;
+}
+
+// RAM index of a SP256K (HIWORD parameter : 16-bit half of the words)
+int JiveSim::dpiSpramMem(int hiword)
+{
+    return (mem_slot << 1) | (hiword & 1);
+}
+
+// Register file half of the calling scope (-1 : not an EBR_B of the register file)
+int JiveSim::ebr_half(void)
+{
+    svScope scope = svGetScope();
+    
+    for (int i = 0; i < ebr_num; i++)
+    {
+        if (ebr_scope[i] == scope) return i;
+    }
+    printf("EBR model not found !\n");
+    return -1;
+}
+
+// DPI-C functions : instance of the calling scope
+
+static inline JiveSim *dpi_sim(void)
+{
+    return (JiveSim *)svGetUserData(svGetScope(), (void *)&dpi_key);
+}
+
+void riscv_disasm(int instr, int pc, svBitVecVal *dasm)
+{
+    dpi_sim()->dpiDisasm((vluint32_t)instr, (vluint32_t)pc, (vluint32_t *)dasm);
+}
+
+void uart_tx(int data)
+{
+    dpi_sim()->dpiUartTx(data);
+}
+
+void ebr_init(int index, int data)
+{
+    dpi_sim()->dpiEbrInit(index, data);
+}
+
+int ebr_mem(void)
+{
+    return dpi_sim()->dpiEbrMem();
+}
+
+int reset_pc(int pc)
+{
+    return dpi_sim()->dpiResetPc(pc);
+}
+
+int reset_mie(int mie)
+{
+    return dpi_sim()->dpiResetMie(mie);
+}
+
+long long reset_timer(int index, long long value)
+{
+    return dpi_sim()->dpiResetTimer(index, value);
+}
+
+int spram_mem(int hiword)
+{
+    return dpi_sim()->dpiSpramMem(hiword);
+}
+
+// DPI-C functions : memory accesses (index from spram_mem() / ebr_mem())
+
+// 16-bit word of the RAM
+int spram_read(int mem, int addr)
+{
+    const vluint8_t *p = mem_table[(mem >> 1) & (JIVE_MEM_SLOTS - 1)]->ram
+                       + ((addr & 16383) << 2) + ((mem & 1) << 1);
+    
+    return (int)p[0] | ((int)p[1] << 8);
+}
+
+// 16-bit word of the RAM, one mask bit per nibble (MASKWE)
+void spram_write(int mem, int addr, int data, int mask)
+{
+    static const vluint16_t nib_mask[16] =
+    {
+        0x0000, 0x000F, 0x00F0, 0x00FF, 0x0F00, 0x0F0F, 0x0FF0, 0x0FFF,
+        0xF000, 0xF00F, 0xF0F0, 0xF0FF, 0xFF00, 0xFF0F, 0xFFF0, 0xFFFF
+    };
+    vluint8_t *p = mem_table[(mem >> 1) & (JIVE_MEM_SLOTS - 1)]->ram
+                 + ((addr & 16383) << 2) + ((mem & 1) << 1);
+    vluint16_t m = nib_mask[mask & 15];
+    vluint16_t w;
+    
+    w = ((vluint16_t)p[0] | ((vluint16_t)p[1] << 8)) & ~m;
+    w = w | ((vluint16_t)data & m);
+    p[0] = (vluint8_t)(w);
+    p[1] = (vluint8_t)(w >> 8);
+}
+
+// 16-bit word of the register file
+int ebr_read(int mem, int addr)
+{
+    return (int)mem_table[(mem >> 1) & (JIVE_MEM_SLOTS - 1)]->ebr[mem & 1][addr & 255];
+}
+
+// 16-bit word of the register file, one mask bit per data bit
+void ebr_write(int mem, int addr, int data, int mask)
+{
+    vluint16_t *p = &mem_table[(mem >> 1) & (JIVE_MEM_SLOTS - 1)]->ebr[mem & 1][addr & 255];
+    
+    *p = (*p & ~(vluint16_t)mask) | ((vluint16_t)data & (vluint16_t)mask);
+}
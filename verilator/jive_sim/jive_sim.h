@@ -0,0 +1,226 @@
+#ifndef _JIVE_SIM_H_
+#define _JIVE_SIM_H_
+
+#include "Vjive_soc_top.h"
+#include "verilated.h"
+#include "svdpi.h"
+#include "../clock_gen/clock_gen.h"
+#include "../riscv_trace/riscv_trace.h"
+#include "../riscv_sim/riscv_sim.h"
+#include "../profiler/profiler.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+#if VM_TRACE
+#include "verilated_vcd_c.h"
+#endif
+
+// Period for a 100 MHz clock
+#define PERIOD_100MHz_ps      ((vluint64_t)10000)
+
+// Fast-forward : instructions executed at most to leave a handler
+#define FFWD_ISR_MAX          ((vluint64_t)1000000)
+
+// Threads of the Verilated model (Verilator --threads, see compile.sh)
+#ifndef JIVE_THREADS
+#define JIVE_THREADS          (1)
+#endif
+
+// Clock cycles run per call of the simulation loop (cycle stepping)
+#define JIVE_LOOP_CYCLES      ((vluint64_t)1024)
+
+// Clock cycles per bit of the UART (BAUD_RATE of jive_uart under Verilator)
+#define UART_BAUD_CYCLES      ((vluint64_t)100)
+
+// Idle skip : identical loop iterations in a row (or cycles without any bus activity)
+// before jumping over the next ones, longest loop iteration and time skip step
+#define IDLE_MATCH_ITER       (2)
+#define IDLE_STALL_CYCLES     ((vluint64_t)1024)
+#define IDLE_MAX_CYCLES       ((vluint64_t)65536)
+#define IDLE_MAX_GRAIN        ((vluint64_t)1 << 24)
+// Idle skip : iterations not matching before looking for another loop head
+#define IDLE_MAX_MISS         (8)
+#define IDLE_NO_HEAD          ((vluint32_t)0xFFFFFFFF)
+// Free running counters kept in phase by the idle skip : LSOSC CLKLF period
+// (bit #10 of the counter, in clock cycles) and UART baud rate (UART_BAUD_CYCLES)
+#define IDLE_LSOSC_CYCLES     ((vluint64_t)2048)
+
+// Simulation exit codes
+#define JIVE_EXIT_PASS        (0)   // Simulation completed
+#define JIVE_EXIT_MISMATCH    (1)   // Lockstep mismatch (fail-fast)
+#define JIVE_EXIT_SIGNATURE   (2)   // Signature differs from the reference
+
+// Memories of one SoC instance, owned by the testbench (DPI-C calls of SP256K.v and EBR_B.v)
+typedef struct
+{
+    vluint8_t  ram[65536];      // 64 KB RAM @ 0x80000000 (U_spram_lo : bytes 0 - 1, U_spram_hi : bytes 2 - 3)
+    vluint16_t ebr[2][256];     // Register file (ebr_scope[] order)
+} jive_mem_t;
+
+// SoC instances with their memories attached at the same time
+#define JIVE_MEM_SLOTS        (256)
+
+// Testbench configuration (command line parameters)
+typedef struct
+{
+    // Simulation end time stamp (in ps)
+    vluint64_t max_step;
+    // Signature location
+    vluint32_t sig_beg;
+    vluint32_t sig_end;
+    // Program symbols for the trace and the disassembly (NULL : none, kept by the caller)
+    SymTable  *syms;
+    // Output files
+    char       trc_name[256];       // Trace base name
+    char       vcd_name[256];       // VCD file (empty : no VCD)
+    char       uart_name[256];      // UART output of the Verilog model
+    char       ffwd_uart[256];      // UART output of the ISS (fast-forward)
+    // Trace format, worker thread ring size (0 : no worker)
+    int        trc_fmt;
+    vluint32_t trc_ring;
+    // Trace capture triggers and history depth
+    int        trg_type[2];
+    vluint64_t trg_value[2];
+    int        trc_hist;
+    // Trace segment size (0 : no rotation) and compression level (0 : none)
+    vluint64_t trc_seg;
+    int        trc_gz;
+    // Fail-fast : instructions kept for the mismatch report (0 : disabled)
+    int        fail_depth;
+    // Reference signature (empty : none)
+    char       sig_name[256];
+    // ISS fast-forward : trigger and clock cycles per instruction
+    int        ffwd_type;
+    vluint64_t ffwd_value;
+    vluint32_t ffwd_cpi;
+    // Simulation checkpoints : file names (empty : none) and save time stamp
+    char       save_name[256];
+    vluint64_t save_ps;
+    char       rest_name[256];
+    // Idle skip : time skip over the steady loops and the bus stalls (0 : disabled)
+    int        idle_skip;
+    // Start in the UART/S-Record boot ROM instead of the RAM (0 : RAM)
+    int        boot_rom;
+    // UART input file (empty : none), whole bytes into the holding register (0 : 8N1 frames)
+    char       uart_in[256];
+    int        uart_fast;
+    // Guest profile files : flat profile and callgrind call graph (empty : none)
+    char       prof_name[256];
+    char       cg_name[256];
+} jive_cfg_t;
+
+// One SoC instance : Verilated model with its own context, clocks, ISS and outputs
+class JiveSim
+{
+    public:
+        // Constructor and destructor
+        JiveSim(const jive_cfg_t *cfg, const vluint8_t *ram_init);
+        ~JiveSim();
+        // Methods
+        int  reset(const jive_cfg_t *cfg, const vluint8_t *ram_init);
+        int  start(void);
+        bool step(void);
+        bool runCycles(vluint64_t num);
+        bool runInstr(vluint64_t num);
+        int  finish(void);
+        vluint64_t getTimeStampPs(void);
+        vluint8_t *getRam(void);
+        // DPI-C calls of the Verilog model (routed through the scope user data)
+        void       dpiDisasm(vluint32_t inst, vluint32_t pc, vluint32_t *text);
+        void       dpiUartTx(int data);
+        void       dpiEbrInit(int index, int data);
+        int        dpiEbrMem(void);
+        int        dpiResetPc(int pc);
+        int        dpiResetMie(int mie);
+        long long  dpiResetTimer(int index, long long value);
+        int        dpiSpramMem(int hiword);
+    private:
+        // Clocks, trace and outputs of one test
+        void        init_test(void);
+        void        free_test(void);
+        void        eval_step(void);
+        bool        run_cycles(vluint64_t num, bool to_fetch);
+        bool        keep_running(void);
+        // Idle skip : loop / stall detection and time skip
+        void        idle_reset(void);
+        void        idle_sample(void);
+        void        idle_jump(vluint64_t period, vluint64_t inst);
+        // UART input (+uartin)
+        int         uart_load(const char *name);
+        void        uart_feed(void);
+        // ISS fast-forward and hand-off
+        void        fast_forward(void);
+        void        hoff_set(int index, vluint32_t value);
+        // Register file half of the calling EBR_B model
+        int         ebr_half(void);
+        // Simulation checkpoints
+        int         save_checkpoint(const char *name);
+        int         restore_checkpoint(const char *name);
+        // Testbench configuration
+        jive_cfg_t  cfg;
+        // Verilated model and its context
+        VerilatedContext *ctx;
+        Vjive_soc_top    *top;
+#if VM_TRACE
+        VerilatedVcdC    *tfp;
+#endif
+        // Memory models initialized again by reset()
+        svScope     spram_scope[2];
+        int         spram_num;
+        svScope     ebr_scope[2];
+        int         ebr_num;
+        // Models moved forward by the idle skip (timer, LSOSC, CSR, UART)
+        svScope     timer_scope;
+        svScope     lsosc_scope;
+        svScope     csr_scope;
+        svScope     uart_scope;
+        // Clocks generation
+        ClockGen   *clk;
+        // RISC-V tracing and lockstep checking
+        RISCVTrace *trc;
+        // Guest profiler (NULL : disabled)
+        Profiler   *prof;
+        // SoC model of the ISS fast-forward
+        RISCVSim   *ffwd_sim;
+        // Mismatch report file
+        char        fail_name[256];
+        // UART output of the Verilog model
+        FILE       *uart_fh;
+        // UART input : file contents, next byte, bit on the line (-1 : none),
+        // clock cycles left for this bit and 8N1 frame being sent
+        vluint8_t  *uart_in_buf;
+        vluint32_t  uart_in_len;
+        vluint32_t  uart_in_pos;
+        int         uart_in_bit;
+        vluint32_t  uart_in_cnt;
+        vluint32_t  uart_in_frame;
+        // RAM and register file contents, slot of the DPI-C memory accesses
+        jive_mem_t *mem;
+        int         mem_slot;
+        // ISS hand-off (+ffwd) : register file contents and reset values
+        bool        hoff_on;
+        vluint16_t  hoff_ebr[256];
+        bool        hoff_ebr_ena[256];
+        vluint32_t  hoff_pc;
+        vluint32_t  hoff_mie;
+        vluint64_t  hoff_timer[2];
+        // Idle skip : loop head and last fetch addresses
+        vluint32_t  idle_head;
+        vluint32_t  idle_last;
+        // Idle skip : current iteration (activity hash, clock cycles, fetches, no write / timer read)
+        vluint64_t  idle_hash;
+        vluint64_t  idle_cycles;
+        vluint64_t  idle_inst;
+        bool        idle_clean;
+        // Idle skip : previous iteration, identical / different iterations in a row
+        vluint64_t  idle_prev_hash;
+        vluint64_t  idle_prev_cycles;
+        int         idle_match;
+        int         idle_miss;
+        // Idle skip : cycles without bus activity, cycles skipped, number of skips
+        vluint64_t  idle_quiet;
+        vluint64_t  idle_skipped;
+        vluint64_t  idle_jumps;
+};
+
+#endif /* _JIVE_SIM_H_ */
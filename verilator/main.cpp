@@ -1,151 +1,63 @@
-#include "Vjive_soc_top.h"
 #include "verilated.h"
-#include "clock_gen/clock_gen.h"
-#include "riscv_trace/riscv_trace.h"
+#include "jive_sim/jive_sim.h"
+#include "jive_batch/jive_batch.h"
+#include "sym_table/sym_table.h"
+#include "mem_load/mem_load.h"
 
 #include <ctime>
+#include <chrono>
+#include <thread>
 
-#if VM_TRACE
-#include "verilated_vcd_c.h"
-#endif
-
-// Period for a 100 MHz clock
-#define PERIOD_100MHz_ps      ((vluint64_t)10000)
-
-// Clocks generation (global)
-ClockGen *clk;
-
-// RISC-V tracing (global)
-RISCVTrace *trc;
-
-// 64KB RAM block initialization
-vluint8_t ram_blk_init[65536];
-
-static vluint32_t fgethex(FILE *fh, int digit)
+// Trace trigger : pc:<hex>, sym:<name>, icount:<num>, time:<ps> or write:<hex>
+static int parse_trigger(const char *spec, SymTable *syms, int *type, vluint64_t *value)
 {
-    vluint32_t val = 0;
-    int ch;
-
-    while (digit)
+    if (!strncmp(spec, "pc:", 3))
+    {
+        *type  = TRG_PC;
+        *value = (vluint64_t)strtoul(spec + 3, NULL, 16);
+    }
+    else if (!strncmp(spec, "sym:", 4))
     {
-        digit--;
-        val <<= 4;
+        vluint32_t addr;
         
-        ch = fgetc(fh) - '0';
-        if (ch < 0) break;
-        if (ch >= 17) ch -= 7;
-        val |= (ch & 15);
+        if (syms->find(spec + 4, &addr)) return -1;
+        *type  = TRG_PC;
+        *value = (vluint64_t)addr;
     }
-    
-    return val;
+    else if (!strncmp(spec, "icount:", 7))
+    {
+        *type  = TRG_INSTR;
+        *value = (vluint64_t)strtoull(spec + 7, NULL, 10);
+    }
+    else if (!strncmp(spec, "time:", 5))
+    {
+        *type  = TRG_TIME;
+        *value = (vluint64_t)strtoull(spec + 5, NULL, 10);
+    }
+    else if (!strncmp(spec, "write:", 6))
+    {
+        *type  = TRG_WRITE;
+        *value = (vluint64_t)strtoul(spec + 6, NULL, 16);
+    }
+    else
+    {
+        return -1;
+    }
+    return 0;
 }
 
-static int read_srec(FILE *fh, vluint32_t offs, vluint32_t size, vluint8_t *ptr)
+// Time stamp : <num>[ps|ns|us|ms] (default unit : ps)
+static vluint64_t parse_time(const char *spec)
 {
-    int rec = 0;
-    int line = 1;
+    char *unit;
+    vluint64_t value;
     
-    while (rec < 0x37)
-    {
-        int ch;
-        vluint32_t cks;
-        vluint32_t len;
-        vluint32_t tmp;
-        vluint32_t addr;
-        
-        // Check 'S' character
-        ch = fgetc(fh);
-        if (ch != 'S')
-        {
-            printf("No starting S line #%d!\n", line);
-            return -1;
-        }
-        
-        // Check record type
-        rec = fgetc(fh);
-        switch (rec)
-        {
-            case '0' : // S0 record
-            case '1' : // S1 record
-            case '5' : // S5 record
-            case '9' : // S9 record
-            {
-                cks = fgethex(fh, 2); // 8-bit length
-                len = cks - 2;
-                addr = fgethex(fh, 4); // 16-bit address
-                break;
-            }
-            case '2' : // S2 record
-            case '8' : // S8 record
-            {
-                cks = fgethex(fh, 2); // 8-bit length
-                len = cks - 3;
-                addr = fgethex(fh, 6); // 24-bit address
-                cks += (addr >> 16);
-                break;
-            }
-            case '3' : // S3 record
-            case '7' : // S7 record
-            {
-                cks = fgethex(fh, 2); // 8-bit length
-                len = cks - 4;
-                addr = fgethex(fh, 8); // 32-bit address
-                cks += (addr >> 24);
-                cks += (addr >> 16);
-                break;
-            }
-            default : // Unknown record
-            {
-                printf("Unknown record line #%d!\n", line);
-                return -1;
-            }
-        }
-        
-        cks += (addr >> 8);
-        cks += addr;
-        
-        while (len > 1)
-        {
-            tmp = fgethex(fh, 2);
-            cks += tmp;
-            len--;
-            
-            // S1, S2 or S3 record
-            if ((rec == '1') || (rec == '2') || (rec == '3'))
-            {
-                // Write data to memory
-                if ((addr >= offs) && (addr < (offs + size)))
-                {
-                    ptr[addr - offs] = tmp;
-                }
-                addr++;
-            }
-            
-        }
-        
-        cks += fgethex(fh, 2);
-        cks &= 0xFF;
-        if (cks != 0xFF)
-        {
-            printf("Invalid checksum line #%d!\n", line);
-            return -1;
-        }
-        
-        if (fgetc(fh) != 0x0D)
-        {
-            printf("No EOL CR line #%d!\n", line);
-            return -1;
-        }
-        if (fgetc(fh) != 0x0A)
-        {
-            printf("No EOL LF line #%d!\n", line);
-            return -1;
-        }
-        
-        line ++;
-    }
+    value = (vluint64_t)strtoull(spec, &unit, 10);
+    if (!strcmp(unit, "ns")) value *= (vluint64_t)1000;
+    if (!strcmp(unit, "us")) value *= (vluint64_t)1000000;
+    if (!strcmp(unit, "ms")) value *= (vluint64_t)1000000000;
     
-    return 0;
+    return value;
 }
 
 int main(int argc, char **argv, char **env)
@@ -153,34 +65,42 @@ int main(int argc, char **argv, char **env)
     // Simulation duration
     time_t beg, end;
     double secs;
-    // Trace index
-    int trc_idx = 0;
-    int min_idx = 0;
     // File name generation
     char file_name[256];
-    char trc_name[256];
-    char vcd_name[256];
-    // Simulation steps
-    vluint64_t max_step;
     // Testbench configuration
+    jive_cfg_t cfg;
     const char *arg;
-    // Signature location
-    vluint32_t sig_beg, sig_end;
+    // 64KB RAM block initialization
+    vluint8_t *ram_init;
+    // Program symbols
+    SymTable *syms;
+    // SoC instance
+    JiveSim *sim;
+    int exit_code;
+    // Batch mode worker threads
+    int jobs;
+    // Benchmark mode
+    bool bench;
     
     beg = time(0);
     
     // Parse parameters
     Verilated::commandArgs(argc, argv);
     
+    // Cleared configuration and RAM
+    memset((void *)&cfg, 0, sizeof(cfg));
+    ram_init = new vluint8_t[65536];
+    memset((void *)ram_init, 0, 65536);
+    
     // Default : 1 msec
-    max_step = (vluint64_t)1000000000;
+    cfg.max_step = (vluint64_t)1000000000;
     
     // Simulation duration : +usec=<num>
     arg = Verilated::commandArgsPlusMatch("usec=");
     if ((arg) && (arg[0]))
     {
         arg += 6;
-        max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000;
+        cfg.max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000;
     }
     
     // Simulation duration : +msec=<num>
@@ -188,183 +108,407 @@ int main(int argc, char **argv, char **env)
     if ((arg) && (arg[0]))
     {
         arg += 6;
-        max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000000;
+        cfg.max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000000;
     }
     
-    // S-Record file input for ROM / RAM initialization
+    // S-Record or Intel HEX file input for RAM initialization
     arg = Verilated::commandArgsPlusMatch("srec=");
     if ((arg) && (arg[0]))
     {
-        FILE *fh;
+        mem_region_t reg = { 0x80000000, 0x10000, ram_init, 0 };
+        vluint32_t entry = 0;
         
         arg += 6;
         strncpy(file_name, arg, 255);
-        fh = fopen(file_name, "rb");
-        if (fh)
+        memset((void *)ram_init, 0, 0x10000);
+        if (!read_image(file_name, &reg, 1, &entry))
         {
-            printf("Use file \"%s\" to initialize SPRAM\n", file_name);
-            memset((void *)ram_blk_init, 0, 0x10000);
-            read_srec(fh, 0x80000000, 0x10000, ram_blk_init);
-            fclose(fh);
+            printf("Use file \"%s\" to initialize SPRAM (start address %08X)\n", file_name, entry);
         }
     }
     
-    // Symbols file input for signature location
-    arg = Verilated::commandArgsPlusMatch("syms=");
+    syms = new SymTable();
+    cfg.sig_beg = (vluint32_t)0;
+    cfg.sig_end = (vluint32_t)0;
+    
+    // ELF file input for RAM initialization and symbols
+    arg = Verilated::commandArgsPlusMatch("elf=");
     if ((arg) && (arg[0]))
     {
-        FILE *fh;
+        mem_region_t reg = { 0x80000000, 0x10000, ram_init, 0 };
+        vluint32_t entry = 0;
         
+        arg += 5;
+        strncpy(file_name, arg, 255);
+        memset((void *)ram_init, 0, 0x10000);
+        if (!read_elf(file_name, &reg, 1, syms, &entry))
+        {
+            printf("Use file \"%s\" to initialize SPRAM (start address %08X, %d symbols)\n",
+                   file_name, entry, syms->count());
+        }
+    }
+    
+    // Symbols file input for signature location and trace triggers
+    arg = Verilated::commandArgsPlusMatch("syms=");
+    if ((arg) && (arg[0]))
+    {
         arg += 6;
         strncpy(file_name, arg, 255);
-        fh = fopen(file_name, "rb");
-        if (fh)
+        if (!syms->loadSyms(file_name))
         {
-            vluint32_t tmp1, tmp2;
-            char ch, str1[32], str2[32];
-            
             printf("Use file \"%s\" for signature location\n", file_name);
-            while (!feof(fh))
-            {
-                if (fscanf(fh, "%08x %c       .%s  %08x %s", &tmp1, &ch, str1, &tmp2, str2) == 5)
-                {
-                    if ((ch == 'g') && (tmp2 == 0) && (!strcmp(str1, "data")))
-                    {
-                        if (!strcmp(str2, "begin_signature"))
-                        {
-                            sig_beg = tmp1;
-                            printf("%s = %08X\n", str2, tmp1);
-                        }
-                        if (!strcmp(str2, "end_signature"))
-                        {
-                            sig_end = tmp1;
-                            printf("%s = %08X\n", str2, tmp1);
-                        }
-                    }
-                }
-                //else
-                //{
-                //    printf("%08x %c       .%s  %08x %s", tmp1, ch, str1, tmp2, str2);
-                //}
-            }
-            fclose(fh);
         }
     }
-    else
+    if (!syms->find("begin_signature", &cfg.sig_beg))
+    {
+        printf("%s = %08X\n", "begin_signature", cfg.sig_beg);
+    }
+    if (!syms->find("end_signature", &cfg.sig_end))
     {
-        sig_beg = (vluint32_t)0;
-        sig_end = (vluint32_t)0;
+        printf("%s = %08X\n", "end_signature", cfg.sig_end);
     }
+    cfg.syms = syms;
     
     arg = Verilated::commandArgsPlusMatch("trc=");
     if ((arg) && (arg[0]))
     {
         arg += 5;
-        strncpy(trc_name, arg, 255);
+        strncpy(cfg.trc_name, arg, 255);
+    }
+    else
+    {
+        strcpy(cfg.trc_name, "riscv");
+    }
+    
+    // Trace format : +trcfmt=text (default) or +trcfmt=bin
+    arg = Verilated::commandArgsPlusMatch("trcfmt=");
+    if ((arg) && (arg[0]))
+    {
+        arg += 8;
+        cfg.trc_fmt = (!strcmp(arg, "bin")) ? TRC_FMT_BIN : TRC_FMT_TEXT;
+    }
+    else
+    {
+        cfg.trc_fmt = TRC_FMT_TEXT;
+    }
+    
+    // Lockstep checking in a worker thread : +trcasync or +trcasync=<ring size>
+    arg = Verilated::commandArgsPlusMatch("trcasync");
+    if ((arg) && (arg[0]))
+    {
+        arg += 9;
+        cfg.trc_ring = (arg[0] == '=') ? (vluint32_t)atoi(arg + 1) : (vluint32_t)65536;
     }
     else
     {
-        strcpy(trc_name, "riscv");
+        cfg.trc_ring = (vluint32_t)0;
+    }
+    
+    // Trace segments : +trcseg=<MB> (rotation), +trcgz or +trcgz=<level> (compression)
+    arg = Verilated::commandArgsPlusMatch("trcseg=");
+    if ((arg) && (arg[0]))
+    {
+        arg += 8;
+        cfg.trc_seg = (vluint64_t)atoi(arg) << 20;
+    }
+    else
+    {
+        cfg.trc_seg = (vluint64_t)0;
+    }
+    arg = Verilated::commandArgsPlusMatch("trcgz");
+    if ((arg) && (arg[0]))
+    {
+        arg += 6;
+        cfg.trc_gz = (arg[0] == '=') ? atoi(arg + 1) : 1;
+    }
+    else
+    {
+        cfg.trc_gz = 0;
+    }
+    
+    // Reference signature, compared at the end of the test : +sigref=<name>
+    arg = Verilated::commandArgsPlusMatch("sigref=");
+    if ((arg) && (arg[0]))
+    {
+        arg += 8;
+        strncpy(cfg.sig_name, arg, 255);
+        cfg.sig_name[255] = (char)0;
+    }
+    else
+    {
+        cfg.sig_name[0] = (char)0;
+    }
+    
+    // Stop at the first lockstep mismatch : +failfast or +failfast=<num> (last instructions reported)
+    arg = Verilated::commandArgsPlusMatch("failfast");
+    if ((arg) && (arg[0]))
+    {
+        arg += 9;
+        cfg.fail_depth = (arg[0] == '=') ? atoi(arg + 1) : 32;
+        if (cfg.fail_depth < 1) cfg.fail_depth = 1;
+    }
+    else
+    {
+        cfg.fail_depth = 0;
+    }
+    
+    // Guest profile : +prof (<trace>_profile.txt) or +prof=<file>
+    arg = Verilated::commandArgsPlusMatch("prof");
+    if ((arg) && (arg[0]))
+    {
+        arg += 5;
+        if (arg[0] == '=')
+        {
+            strncpy(cfg.prof_name, arg + 1, 255);
+            cfg.prof_name[255] = (char)0;
+        }
+        else
+        {
+            snprintf(cfg.prof_name, sizeof(cfg.prof_name), "%s_profile.txt", cfg.trc_name);
+        }
+    }
+    else
+    {
+        cfg.prof_name[0] = (char)0;
+    }
+    // Call graph : +callgrind (<trace>_callgrind.out) or +callgrind=<file>
+    arg = Verilated::commandArgsPlusMatch("callgrind");
+    if ((arg) && (arg[0]))
+    {
+        arg += 10;
+        if (arg[0] == '=')
+        {
+            strncpy(cfg.cg_name, arg + 1, 255);
+            cfg.cg_name[255] = (char)0;
+        }
+        else
+        {
+            snprintf(cfg.cg_name, sizeof(cfg.cg_name), "%s_callgrind.out", cfg.trc_name);
+        }
+    }
+    else
+    {
+        cfg.cg_name[0] = (char)0;
     }
     
     arg = Verilated::commandArgsPlusMatch("vcd=");
     if ((arg) && (arg[0]))
     {
         arg += 5;
-        strncpy(vcd_name, arg, 251);
+        strncpy(cfg.vcd_name, arg, 251);
     }
     else
     {
-        strcpy(vcd_name, "riscv.vcd");
+        strcpy(cfg.vcd_name, "riscv.vcd");
+    }
+    
+    // Trace capture window : +trcon=<trigger>, +trcoff=<trigger>
+    for (int i = 0; i < 2; i++)
+    {
+        arg = Verilated::commandArgsPlusMatch((i == TRG_START) ? "trcon=" : "trcoff=");
+        if ((arg) && (arg[0]))
+        {
+            arg += (i == TRG_START) ? 7 : 8;
+            if (parse_trigger(arg, syms, &cfg.trg_type[i], &cfg.trg_value[i]))
+            {
+                printf("Invalid trace trigger \"%s\"\n", arg);
+                cfg.trg_type[i] = TRG_NONE;
+            }
+        }
+        else
+        {
+            cfg.trg_type[i] = TRG_NONE;
+        }
     }
     
-    // Initialize top verilog instance
-    Vjive_soc_top* top = new Vjive_soc_top;
+    // Instructions kept before the start trigger : +trchist=<num>
+    arg = Verilated::commandArgsPlusMatch("trchist=");
+    if ((arg) && (arg[0]))
+    {
+        arg += 9;
+        cfg.trc_hist = atoi(arg);
+    }
+    else
+    {
+        cfg.trc_hist = 0;
+    }
     
-    // Initialize clock generator    
-    clk = new ClockGen(1, max_step);
-    // 100 MHz clock
-    clk->NewClock(0, PERIOD_100MHz_ps, 0);
-    clk->StartClock(0);
+    // ISS fast-forward before the Verilog model : +ffwd=<trigger> (pc:, sym: or icount:)
+    arg = Verilated::commandArgsPlusMatch("ffwd=");
+    if ((arg) && (arg[0]))
+    {
+        arg += 6;
+        if ((parse_trigger(arg, syms, &cfg.ffwd_type, &cfg.ffwd_value)) ||
+            ((cfg.ffwd_type != TRG_PC) && (cfg.ffwd_type != TRG_INSTR)))
+        {
+            printf("Invalid fast-forward trigger \"%s\"\n", arg);
+            cfg.ffwd_type = TRG_NONE;
+        }
+    }
+    else
+    {
+        cfg.ffwd_type = TRG_NONE;
+    }
     
-    // Initialize RISC-V trace
-    trc = new RISCVTrace(0x80000000, sig_beg, sig_end);
-    trc->open(trc_name);
+    // Clock cycles per instruction during the fast-forward : +ffcpi=<num>
+    arg = Verilated::commandArgsPlusMatch("ffcpi=");
+    if ((arg) && (arg[0]) && (atoi(arg + 7) > 0))
+    {
+        cfg.ffwd_cpi = (vluint32_t)atoi(arg + 7);
+    }
+    else
+    {
+        cfg.ffwd_cpi = (vluint32_t)16;
+    }
     
-#if VM_TRACE
-    // Initialize VCD trace dump
-    Verilated::traceEverOn(true);
-    VerilatedVcdC* tfp = new VerilatedVcdC;
-    top->trace (tfp, 99);
-    tfp->spTrace()->set_time_resolution ("1 ps");
-    tfp->open (vcd_name);
-#endif /* VM_TRACE */
-  
-    // Simulation loop
-    while (!clk->EndOfSimulation())
+    // Simulation checkpoint : +save=<file>@<time> (ps, ns, us or ms)
+    arg = Verilated::commandArgsPlusMatch("save=");
+    cfg.save_name[0] = (char)0;
+    cfg.save_ps = (vluint64_t)0;
+    if ((arg) && (arg[0]))
     {
-        clk->AdvanceClocks();
-        top->clk = clk->GetClockStateDiv1(0,0);
-        
-        // Evaluate verilated model
-        top->eval ();
+        char *at;
         
-        // RISC-V trace
-        trc->dump (clk->GetTimeStampPs(), top->clk,
-                   top->i_rd_ack,  top->i_address, top->i_rddata,
-                   top->d_rd_ack,  top->d_wr_ack,  top->d_address,
-                   top->d_byteena, top->d_rddata,  top->d_wrdata,
-                   0,
-                   top->wb_ena,    top->wb_idx,    top->wb_data);
-    
-#if VM_TRACE
-        // Dump signals into VCD file
-        if (tfp)
+        arg += 6;
+        strncpy(cfg.save_name, arg, 255);
+        cfg.save_name[255] = (char)0;
+        at = strrchr(cfg.save_name, '@');
+        if ((at) && (at != cfg.save_name))
         {
-            tfp->dump (clk->GetTimeStampPs());
+            *at = (char)0;
+            cfg.save_ps = parse_time(at + 1);
+        }
+        else
+        {
+            printf("Invalid checkpoint \"%s\"\n", arg);
+            cfg.save_name[0] = (char)0;
         }
-#endif /* VM_TRACE */
-
-        if (Verilated::gotFinish()) break;
     }
     
-#if VM_TRACE
-    if (tfp) tfp->close();
-#endif /* VM_TRACE */
-
-    top->final();
+    // Simulation restart from a checkpoint : +restore=<file>
+    arg = Verilated::commandArgsPlusMatch("restore=");
+    if ((arg) && (arg[0]))
+    {
+        arg += 9;
+        strncpy(cfg.rest_name, arg, 255);
+        cfg.rest_name[255] = (char)0;
+    }
+    else
+    {
+        cfg.rest_name[0] = (char)0;
+    }
     
-    trc->close();
+    // Benchmark : +bench (no VCD, simulated cycles per second of the model)
+    arg = Verilated::commandArgsPlusMatch("bench");
+    bench = ((arg) && (arg[0]));
+    if (bench)
+    {
+        cfg.vcd_name[0] = (char)0;
+    }
     
-    delete top;
+    // Idle skip : +idleskip (steady loops and bus stalls jumped over up to the next event)
+    arg = Verilated::commandArgsPlusMatch("idleskip");
+    cfg.idle_skip = ((arg) && (arg[0])) ? 1 : 0;
     
-    delete trc;
+    // Boot ROM : +boot (the UART/S-Record bootloader runs first)
+    arg = Verilated::commandArgsPlusMatch("boot");
+    cfg.boot_rom = ((arg) && (arg[0])) ? 1 : 0;
+    
+    // UART input : +uartin=<file> (8N1 frames on uart_rxd), +uartfast (whole bytes)
+    arg = Verilated::commandArgsPlusMatch("uartin=");
+    if ((arg) && (arg[0]))
+    {
+        arg += 8;
+        strncpy(cfg.uart_in, arg, 255);
+        cfg.uart_in[255] = (char)0;
+    }
+    else
+    {
+        cfg.uart_in[0] = (char)0;
+    }
+    arg = Verilated::commandArgsPlusMatch("uartfast");
+    cfg.uart_fast = ((arg) && (arg[0])) ? 1 : 0;
     
-    delete clk;
+    // UART outputs
+    strcpy(cfg.uart_name, "uart_tx.log");
+    strcpy(cfg.ffwd_uart, "uart_tx_ffwd.log");
+    
+    // Batch mode : +batch=<manifest>, +jobs=<num> worker threads (default : one per CPU)
+    arg = Verilated::commandArgsPlusMatch("jobs=");
+    if ((arg) && (arg[0]))
+    {
+        arg += 6;
+        jobs = atoi(arg);
+    }
+    else
+    {
+        jobs = (int)std::thread::hardware_concurrency();
+    }
+    arg = Verilated::commandArgsPlusMatch("batch=");
+    if ((arg) && (arg[0]))
+    {
+        JiveBatch *batch;
+        
+        arg += 7;
+        strncpy(file_name, arg, 247);
+        file_name[247] = (char)0;
+        batch = new JiveBatch(&cfg, jobs);
+        if (batch->loadManifest(file_name) > 0)
+        {
+            exit_code = (batch->run()) ? JIVE_EXIT_MISMATCH : JIVE_EXIT_PASS;
+            strcat(file_name, ".summary");
+            batch->writeSummary(file_name);
+        }
+        else
+        {
+            exit_code = JIVE_EXIT_MISMATCH;
+        }
+        delete batch;
+    }
+    else
+    {
+        // Initialize the SoC instance
+        sim = new JiveSim(&cfg, ram_init);
+        if (sim->start())
+        {
+            exit(1);
+        }
+        
+        // Simulation loop
+        if (bench)
+        {
+            std::chrono::steady_clock::time_point t0;
+            vluint64_t ps0, cycles;
+            double run_s;
+            
+            t0  = std::chrono::steady_clock::now();
+            ps0 = sim->getTimeStampPs();
+            
+            while (sim->runCycles(JIVE_LOOP_CYCLES));
+            
+            run_s  = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            cycles = (sim->getTimeStampPs() - ps0) / PERIOD_100MHz_ps;
+            printf("\nBenchmark : %d model threads, %llu cycles in %.3f s, %.0f cycles/s\n", JIVE_THREADS,
+                   (unsigned long long)cycles, run_s, (run_s > 0.0) ? (double)cycles / run_s : 0.0);
+        }
+        else
+        {
+            while (sim->runCycles(JIVE_LOOP_CYCLES));
+        }
+        
+        exit_code = sim->finish();
+        
+        delete sim;
+    }
+    
+    delete syms;
+    
+    delete [] ram_init;
   
     // Calculate running time
     end = time(0);
     secs = difftime(end, beg);
     printf("\nSeconds elapsed : %f\n", secs);
 
-    exit(0);
-}
-
-// DPI-C functions
-
-char riscv_disasm(int instr, int pc, int idx)
-{
-    return trc->disasm((vluint32_t)instr, (vluint32_t)pc, idx);
-}
-
-int spram_init(int index)
-{
-    vluint32_t tmp;
-    
-    tmp = ((vluint32_t)ram_blk_init[((index & 16383) << 2) + 0] <<  0)
-        | ((vluint32_t)ram_blk_init[((index & 16383) << 2) + 1] <<  8)
-        | ((vluint32_t)ram_blk_init[((index & 16383) << 2) + 2] << 16)
-        | ((vluint32_t)ram_blk_init[((index & 16383) << 2) + 3] << 24);
-    
-    return tmp;
+    exit(exit_code);
 }
@@ -0,0 +1,427 @@
+#include "verilated.h"
+#include "mem_load.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Hexadecimal digit values (0xFF : not a digit)
+static const vluint8_t hex_val[256] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+// S-Record types S0 - S9 : address bytes, data record, start address record
+static const struct
+{
+    vluint8_t addr;
+    bool      data;
+    bool      start;
+} srec_type[10] =
+{
+    { 2, false, false },    // S0 : header
+    { 2, true,  false },    // S1 : data, 16-bit address
+    { 3, true,  false },    // S2 : data, 24-bit address
+    { 4, true,  false },    // S3 : data, 32-bit address
+    { 0, false, false },    // S4 : reserved
+    { 2, false, false },    // S5 : 16-bit record count
+    { 3, false, false },    // S6 : 24-bit record count
+    { 4, false, true  },    // S7 : start, 32-bit address
+    { 3, false, true  },    // S8 : start, 24-bit address
+    { 2, false, true  }     // S9 : start, 16-bit address
+};
+
+// Intel HEX record types : data bytes expected (-1 : any)
+static const int ihex_len[6] =
+{
+    -1,     // 00 : data
+     0,     // 01 : end of file
+     2,     // 02 : extended segment address
+     4,     // 03 : start segment address
+     2,     // 04 : extended linear address
+     4      // 05 : start linear address
+};
+
+// Map a whole file in memory (NULL : error, message printed)
+static const vluint8_t *map_file(const char *name, size_t *len)
+{
+    struct stat st;
+    void *img;
+    int fd;
+    
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Cannot open \"%s\" !\n", name);
+        return NULL;
+    }
+    if ((fstat(fd, &st)) || (!st.st_size))
+    {
+        printf("File \"%s\" is empty !\n", name);
+        close(fd);
+        return NULL;
+    }
+    img = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (img == MAP_FAILED)
+    {
+        printf("Cannot map \"%s\" !\n", name);
+        return NULL;
+    }
+    *len = (size_t)st.st_size;
+    
+    return (const vluint8_t *)img;
+}
+
+// Copy bytes into the regions (src NULL : cleared), returns the bytes not copied
+static vluint32_t put_bytes(mem_region_t *reg, int num, vluint64_t addr, const vluint8_t *src, vluint32_t len)
+{
+    vluint32_t left = len;
+    
+    for (int i = 0; i < num; i++)
+    {
+        vluint64_t beg = addr;
+        vluint64_t end = addr + len;
+        
+        // Part of the bytes inside the region
+        if (beg < reg[i].offs) beg = reg[i].offs;
+        if (end > (vluint64_t)reg[i].offs + reg[i].size) end = (vluint64_t)reg[i].offs + reg[i].size;
+        if (beg >= end) continue;
+        
+        if (src)
+        {
+            memcpy((void *)(reg[i].ptr + (beg - reg[i].offs)), (const void *)(src + (beg - addr)), end - beg);
+        }
+        else
+        {
+            memset((void *)(reg[i].ptr + (beg - reg[i].offs)), 0, end - beg);
+        }
+        reg[i].used += (vluint32_t)(end - beg);
+        left -= (vluint32_t)(end - beg);
+    }
+    
+    return left;
+}
+
+/******************************************************************************/
+/** Load a memory image file : Motorola S-Record (S1/S2/S3 data, S7/S8/S9    **/
+/** start address) or Intel HEX (00 data, 02/04 extended address, 03/05      **/
+/** start address), one record per line (LF or CR/LF). The data falling      **/
+/** outside the regions are counted and ignored.                             **/
+/**   name  : image file name                                                **/
+/**   reg   : memory regions                                                 **/
+/**   num   : number of regions                                              **/
+/**   entry : start address (NULL : not needed)                              **/
+/******************************************************************************/
+int read_image(const char *name, mem_region_t *reg, int num, vluint32_t *entry)
+{
+    const vluint8_t *img;
+    const vluint8_t *p;
+    const vluint8_t *img_end;
+    vluint8_t rec[262];
+    vluint32_t base;
+    vluint32_t lost;
+    size_t len;
+    int line;
+    bool done;
+    
+    img = map_file(name, &len);
+    if (!img) return -1;
+    
+    img_end = img + len;
+    p       = img;
+    base    = 0;
+    lost    = 0;
+    line    = 0;
+    done    = false;
+    
+    while ((!done) && (p < img_end))
+    {
+        vluint8_t kind;
+        vluint8_t type;
+        vluint32_t n;
+        vluint32_t cks;
+        vluint32_t addr;
+        
+        // Next line, empty lines skipped
+        if ((*p == 0x0A) || (*p == 0x0D) || (*p == ' ') || (*p == '\t'))
+        {
+            if (*p == 0x0A) line++;
+            p++;
+            continue;
+        }
+        kind = *p++;
+        type = 0;
+        if (kind == 'S')
+        {
+            type = (p < img_end) ? *p++ - '0' : 0xFF;
+            if ((type > 9) || (!srec_type[type].addr))
+            {
+                printf("Unknown record line #%d!\n", line + 1);
+                munmap((void *)img, len);
+                return -1;
+            }
+        }
+        else if (kind != ':')
+        {
+            printf("No starting S or : line #%d!\n", line + 1);
+            munmap((void *)img, len);
+            return -1;
+        }
+        
+        // Record bytes up to the end of the line
+        n = 0;
+        while ((p + 1 < img_end) && (n < sizeof(rec)))
+        {
+            vluint8_t hi = hex_val[p[0]];
+            vluint8_t lo = hex_val[p[1]];
+            
+            if ((hi | lo) & 0xF0) break;
+            rec[n++] = (hi << 4) | lo;
+            p += 2;
+        }
+        while ((p < img_end) && ((*p == ' ') || (*p == '\t') || (*p == 0x0D))) p++;
+        if ((p < img_end) && (*p != 0x0A))
+        {
+            printf("Invalid character line #%d!\n", line + 1);
+            munmap((void *)img, len);
+            return -1;
+        }
+        
+        // Record length and checksum
+        cks = 0;
+        for (vluint32_t i = 0; i < n; i++) cks += rec[i];
+        if (kind == 'S')
+        {
+            if ((n < 2) || (rec[0] != n - 1) || (rec[0] <= srec_type[type].addr))
+            {
+                printf("Invalid length line #%d!\n", line + 1);
+                munmap((void *)img, len);
+                return -1;
+            }
+            if ((cks & 0xFF) != 0xFF)
+            {
+                printf("Invalid checksum line #%d!\n", line + 1);
+                munmap((void *)img, len);
+                return -1;
+            }
+            
+            // Big endian address after the byte count
+            addr = 0;
+            for (vluint32_t i = 1; i <= srec_type[type].addr; i++) addr = (addr << 8) | rec[i];
+            
+            if (srec_type[type].data)
+            {
+                lost += put_bytes(reg, num, addr, rec + 1 + srec_type[type].addr,
+                                  n - 2 - srec_type[type].addr);
+            }
+            if (srec_type[type].start)
+            {
+                if (entry) *entry = addr;
+                done = true;
+            }
+        }
+        else
+        {
+            if ((n < 5) || (rec[0] != n - 5) ||
+                ((rec[3] < 6) && (ihex_len[rec[3]] >= 0) && (rec[0] != ihex_len[rec[3]])))
+            {
+                printf("Invalid length line #%d!\n", line + 1);
+                munmap((void *)img, len);
+                return -1;
+            }
+            if (cks & 0xFF)
+            {
+                printf("Invalid checksum line #%d!\n", line + 1);
+                munmap((void *)img, len);
+                return -1;
+            }
+            
+            addr = ((vluint32_t)rec[1] << 8) | (vluint32_t)rec[2];
+            switch (rec[3])
+            {
+                case 0x00 : // Data
+                {
+                    lost += put_bytes(reg, num, (vluint64_t)((base + addr) & 0xFFFFFFFF), rec + 4, rec[0]);
+                    break;
+                }
+                case 0x01 : // End of file
+                {
+                    done = true;
+                    break;
+                }
+                case 0x02 : // Extended segment address
+                {
+                    base = (((vluint32_t)rec[4] << 8) | (vluint32_t)rec[5]) << 4;
+                    break;
+                }
+                case 0x03 : // Start segment address (CS:IP)
+                {
+                    if (entry) *entry = ((((vluint32_t)rec[4] << 8) | (vluint32_t)rec[5]) << 4)
+                                      + (((vluint32_t)rec[6] << 8) | (vluint32_t)rec[7]);
+                    break;
+                }
+                case 0x04 : // Extended linear address
+                {
+                    base = (((vluint32_t)rec[4] << 8) | (vluint32_t)rec[5]) << 16;
+                    break;
+                }
+                case 0x05 : // Start linear address
+                {
+                    if (entry) *entry = ((vluint32_t)rec[4] << 24) | ((vluint32_t)rec[5] << 16)
+                                      | ((vluint32_t)rec[6] <<  8) |  (vluint32_t)rec[7];
+                    break;
+                }
+                default :
+                {
+                    printf("Unknown record line #%d!\n", line + 1);
+                    munmap((void *)img, len);
+                    return -1;
+                }
+            }
+        }
+    }
+    munmap((void *)img, len);
+    
+    if (lost)
+    {
+        printf("Warning : %u bytes of \"%s\" outside the memory regions\n", lost, name);
+    }
+    
+    return 0;
+}
+
+// Check the ELF magic number of a file
+bool is_elf(const char *name)
+{
+    FILE *fh;
+    unsigned char magic[SELFMAG];
+    bool elf;
+    
+    fh = fopen(name, "rb");
+    if (!fh) return false;
+    
+    elf = (fread(magic, 1, SELFMAG, fh) == SELFMAG) && (!memcmp(magic, ELFMAG, SELFMAG));
+    fclose(fh);
+    
+    return elf;
+}
+
+/******************************************************************************/
+/** Load a RV32 ELF executable : the PT_LOAD segments are copied into the    **/
+/** regions (bytes past the file size of a segment are cleared) and the      **/
+/** .symtab symbols go into a table                                          **/
+/**   name  : ELF file name                                                  **/
+/**   reg   : memory regions (physical address of the segments)              **/
+/**   num   : number of regions (0 : symbols only)                           **/
+/**   syms  : symbols table (NULL : symbols not loaded)                      **/
+/**   entry : start address (NULL : not needed)                              **/
+/******************************************************************************/
+int read_elf(const char *name, mem_region_t *reg, int num, SymTable *syms, vluint32_t *entry)
+{
+    const vluint8_t *img;
+    const Elf32_Ehdr *eh;
+    vluint32_t lost;
+    size_t len;
+    
+    img = map_file(name, &len);
+    if (!img) return -1;
+    
+    // 32-bit, little endian, RISC-V executable
+    eh = (const Elf32_Ehdr *)img;
+    if ((len < sizeof(Elf32_Ehdr))                    ||
+        (memcmp(eh->e_ident, ELFMAG, SELFMAG))        ||
+        (eh->e_ident[EI_CLASS] != ELFCLASS32)         ||
+        (eh->e_ident[EI_DATA]  != ELFDATA2LSB)        ||
+        (eh->e_machine != EM_RISCV)                   ||
+        ((vluint64_t)eh->e_phoff + (vluint64_t)eh->e_phnum * sizeof(Elf32_Phdr) > (vluint64_t)len) ||
+        ((vluint64_t)eh->e_shoff + (vluint64_t)eh->e_shnum * sizeof(Elf32_Shdr) > (vluint64_t)len))
+    {
+        printf("File \"%s\" is not a RV32 ELF file !\n", name);
+        munmap((void *)img, len);
+        return -1;
+    }
+    if (entry) *entry = eh->e_entry;
+    
+    // Loadable segments
+    lost = 0;
+    for (int i = 0; (num) && (i < eh->e_phnum); i++)
+    {
+        const Elf32_Phdr *ph = (const Elf32_Phdr *)(img + eh->e_phoff) + i;
+        vluint32_t fsz;
+        
+        if ((ph->p_type != PT_LOAD) || (!ph->p_memsz)) continue;
+        if ((vluint64_t)ph->p_offset + ph->p_filesz > (vluint64_t)len)
+        {
+            printf("Segment #%d out of file \"%s\" !\n", i, name);
+            continue;
+        }
+        
+        fsz   = (ph->p_filesz < ph->p_memsz) ? ph->p_filesz : ph->p_memsz;
+        lost += put_bytes(reg, num, ph->p_paddr, img + ph->p_offset, fsz);
+        lost += put_bytes(reg, num, (vluint64_t)ph->p_paddr + fsz, NULL, ph->p_memsz - fsz);
+    }
+    if (lost)
+    {
+        printf("Warning : %u bytes of \"%s\" outside the memory regions\n", lost, name);
+    }
+    
+    // Symbols (functions, objects and labels)
+    for (int i = 0; (syms) && (i < eh->e_shnum); i++)
+    {
+        const Elf32_Shdr *sh = (const Elf32_Shdr *)(img + eh->e_shoff) + i;
+        const Elf32_Shdr *strh;
+        const Elf32_Sym *sym;
+        const char *str;
+        vluint32_t cnt;
+        
+        if ((sh->sh_type != SHT_SYMTAB) || (sh->sh_link >= eh->e_shnum)) continue;
+        strh = (const Elf32_Shdr *)(img + eh->e_shoff) + sh->sh_link;
+        if (((vluint64_t)sh->sh_offset   + sh->sh_size   > (vluint64_t)len) ||
+            ((vluint64_t)strh->sh_offset + strh->sh_size > (vluint64_t)len) ||
+            (!strh->sh_size))
+        {
+            printf("Symbols table out of file \"%s\" !\n", name);
+            continue;
+        }
+        
+        sym = (const Elf32_Sym *)(img + sh->sh_offset);
+        str = (const char *)(img + strh->sh_offset);
+        cnt = sh->sh_size / sizeof(Elf32_Sym);
+        for (vluint32_t j = 1; j < cnt; j++)
+        {
+            int type = ELF32_ST_TYPE(sym[j].st_info);
+            
+            if ((type == STT_SECTION) || (type == STT_FILE)) continue;
+            if ((sym[j].st_shndx == SHN_UNDEF) || (sym[j].st_name >= strh->sh_size)) continue;
+            // String table not terminated
+            if (memchr(str + sym[j].st_name, 0, strh->sh_size - sym[j].st_name) == NULL) continue;
+            if (!str[sym[j].st_name]) continue;
+            
+            syms->add(str + sym[j].st_name, sym[j].st_value, sym[j].st_size);
+        }
+    }
+    
+    munmap((void *)img, len);
+    
+    return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef _MEM_LOAD_H_
+#define _MEM_LOAD_H_
+
+#include "verilated.h"
+#include "../sym_table/sym_table.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+// Memory region filled by the loaders
+typedef struct
+{
+    vluint32_t  offs;   // Region address
+    vluint32_t  size;   // Region size (in bytes)
+    vluint8_t  *ptr;    // Region contents
+    vluint32_t  used;   // Bytes written by the loader
+} mem_region_t;
+
+// Memory image loaders (entry : start address, unchanged if the file has none)
+int read_image(const char *name, mem_region_t *reg, int num, vluint32_t *entry);
+int read_elf(const char *name, mem_region_t *reg, int num, SymTable *syms, vluint32_t *entry);
+bool is_elf(const char *name);
+
+#endif /* _MEM_LOAD_H_ */
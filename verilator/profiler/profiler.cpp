@@ -0,0 +1,401 @@
+#include "verilated.h"
+#include "profiler.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+// Function of the flat profile
+typedef struct
+{
+    const char  *name;      // Symbol name (or memory)
+    vluint32_t   addr;      // First address seen
+    prof_count_t cnt;       // Instructions and cycles
+} prof_func_t;
+
+// Line of a callgrind function block : self cost of an address or call arc
+typedef struct
+{
+    vluint32_t   addr;      // Instruction address (call site for an arc)
+    int          arc;       // Call graph arc (-1 : self cost)
+    prof_count_t cnt;       // Self cost
+} prof_line_t;
+
+// Function covering an address (addresses without a symbol : memory name)
+static const char *func_name(SymTable *syms, vluint32_t addr)
+{
+    const char *name;
+    vluint32_t offs;
+    
+    if ((syms) && (!syms->lookup(addr, &name, &offs))) return name;
+    if ((addr & 0xFFFF0000) == 0x80000000) return "[RAM]";
+    if (addr < (PROF_ROM_WORDS << 2))      return "[boot ROM]";
+    return "[other]";
+}
+
+// Constructor
+Profiler::Profiler(vluint64_t period_ps)
+{
+    period = (period_ps) ? period_ps : 1;
+    memset((void *)ram_cnt, 0, sizeof(ram_cnt));
+    memset((void *)rom_cnt, 0, sizeof(rom_cnt));
+    memset((void *)&other_cnt, 0, sizeof(other_cnt));
+    last_cnt   = NULL;
+    last_pc    = 0;
+    last_stamp = 0;
+    tot.inst   = 0;
+    tot.cycles = 0;
+    flow_op    = PROF_FLOW_NONE;
+    flow_pc    = 0;
+    stack_num  = 0;
+}
+
+// Destructor
+Profiler::~Profiler()
+{
+}
+
+// Interrupt taken by the Verilog model on the last fetch (handler entry) : the
+// handler frame starts with this instruction
+void Profiler::interrupt(vluint32_t site)
+{
+    prof_count_t entry;
+    
+    entry.inst   = tot.inst - 1;
+    entry.cycles = tot.cycles;
+    push_frame(site, last_pc, true, &entry);
+}
+
+// End of the simulation : cycles of the last instruction, open calls closed
+void Profiler::stop(vluint64_t stamp)
+{
+    if ((last_cnt) && (stamp > last_stamp))
+    {
+        vluint64_t cycles = (stamp - last_stamp) / period;
+        
+        last_cnt->cycles += cycles;
+        tot.cycles       += cycles;
+        last_stamp = stamp;
+    }
+    flow_op = PROF_FLOW_NONE;
+    while (stack_num) pop_frame();
+}
+
+/******************************************************************************/
+/** Shadow call stack                                                        **/
+/******************************************************************************/
+
+// Call graph event of the previous instruction, pc : address fetched after it
+void Profiler::apply_flow(vluint32_t pc)
+{
+    int top = (stack_num < PROF_STACK_DEPTH) ? stack_num : PROF_STACK_DEPTH;
+    int idx;
+    
+    switch (flow_op)
+    {
+        case PROF_FLOW_CALL:
+        case PROF_FLOW_TRAP:
+        {
+            push_frame(flow_pc, pc, (flow_op == PROF_FLOW_TRAP), &tot);
+            break;
+        }
+        case PROF_FLOW_RET:
+        {
+            // Frames beyond the stack depth : assumed to match
+            if (stack_num > PROF_STACK_DEPTH)
+            {
+                pop_frame();
+                break;
+            }
+            // Closest call returning there, not across a handler (no match : stack
+            // switch or longjmp, the frames are kept)
+            for (idx = top - 1; (idx >= 0) && (!stack[idx].trap); idx--)
+            {
+                if (stack[idx].ret_pc == pc) break;
+            }
+            if ((idx >= 0) && (!stack[idx].trap))
+            {
+                while (stack_num > idx) pop_frame();
+            }
+            break;
+        }
+        case PROF_FLOW_MRET:
+        {
+            // Handler frame and the calls it left open
+            for (idx = top - 1; idx >= 0; idx--)
+            {
+                if (stack[idx].trap) break;
+            }
+            if (idx >= 0)
+            {
+                while (stack_num > idx) pop_frame();
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    flow_op = PROF_FLOW_NONE;
+}
+
+// Enter a function (or a handler) : one more call on its arc
+void Profiler::push_frame(vluint32_t site, vluint32_t target, bool trap, const prof_count_t *entry)
+{
+    vluint64_t key = ((vluint64_t)site << 32) | (vluint64_t)target;
+    std::unordered_map<vluint64_t, int>::const_iterator it = arc_idx.find(key);
+    int arc;
+    
+    if (it == arc_idx.end())
+    {
+        prof_arc_t a;
+        
+        a.site        = site;
+        a.target      = target;
+        a.calls       = 0;
+        a.incl.inst   = 0;
+        a.incl.cycles = 0;
+        arc = (int)arcs.size();
+        arcs.push_back(a);
+        arc_idx[key] = arc;
+    }
+    else
+    {
+        arc = it->second;
+    }
+    arcs[arc].calls++;
+    
+    if (stack_num < PROF_STACK_DEPTH)
+    {
+        prof_frame_t *f = &stack[stack_num];
+        
+        f->arc    = arc;
+        f->trap   = trap;
+        f->ret_pc = site + 4;
+        f->entry  = *entry;
+    }
+    stack_num++;
+}
+
+// Leave the innermost function : inclusive counters added to its arc
+void Profiler::pop_frame(void)
+{
+    stack_num--;
+    if (stack_num < PROF_STACK_DEPTH)
+    {
+        const prof_frame_t *f = &stack[stack_num];
+        prof_arc_t *a = &arcs[f->arc];
+        
+        a->incl.inst   += tot.inst   - f->entry.inst;
+        a->incl.cycles += tot.cycles - f->entry.cycles;
+    }
+}
+
+/******************************************************************************/
+/** Write the flat profile : the addresses counters are summed by function   **/
+/** (symbol covering the address, see SymTable::lookup()), then sorted by    **/
+/** clock cycles. Addresses without a symbol are summed per memory (RAM,     **/
+/** boot ROM, other).                                                        **/
+/**   name : profile file name                                               **/
+/**   syms : program symbols (NULL : none)                                   **/
+/******************************************************************************/
+int Profiler::writeFlat(const char *name, SymTable *syms)
+{
+    std::map<const char *, prof_func_t> funcs;
+    std::vector<prof_func_t> list;
+    vluint64_t tot_inst, tot_cycles, cum_cycles;
+    FILE *fh;
+    
+    if ((syms) && (!syms->buildIndex())) syms = NULL;
+    
+    // Sum by function, in address order
+    tot_inst   = 0;
+    tot_cycles = 0;
+    for (int i = 0; i < PROF_RAM_WORDS + PROF_ROM_WORDS + 1; i++)
+    {
+        const prof_count_t *p;
+        const char *func;
+        vluint32_t addr;
+        
+        if (i < PROF_RAM_WORDS)
+        {
+            p    = &ram_cnt[i];
+            addr = 0x80000000 + (i << 2);
+            func = func_name(syms, addr);
+        }
+        else if (i < PROF_RAM_WORDS + PROF_ROM_WORDS)
+        {
+            p    = &rom_cnt[i - PROF_RAM_WORDS];
+            addr = (i - PROF_RAM_WORDS) << 2;
+            func = func_name(syms, addr);
+        }
+        else
+        {
+            p    = &other_cnt;
+            addr = 0xFFFFFFFF;
+            func = func_name(NULL, addr);
+        }
+        if ((!p->inst) && (!p->cycles)) continue;
+        
+        if (funcs.find(func) == funcs.end())
+        {
+            funcs[func].name = func;
+            funcs[func].addr = addr;
+            funcs[func].cnt.inst   = 0;
+            funcs[func].cnt.cycles = 0;
+        }
+        funcs[func].cnt.inst   += p->inst;
+        funcs[func].cnt.cycles += p->cycles;
+        tot_inst   += p->inst;
+        tot_cycles += p->cycles;
+    }
+    
+    // Most expensive first
+    for (std::map<const char *, prof_func_t>::const_iterator it = funcs.begin(); it != funcs.end(); ++it)
+    {
+        list.push_back(it->second);
+    }
+    std::sort(list.begin(), list.end(), [](const prof_func_t &a, const prof_func_t &b)
+    {
+        if (a.cnt.cycles != b.cnt.cycles) return a.cnt.cycles > b.cnt.cycles;
+        return a.addr < b.addr;
+    });
+    
+    fh = fopen(name, "w");
+    if (!fh)
+    {
+        printf("Cannot create profile \"%s\" !\n", name);
+        return -1;
+    }
+    fprintf(fh, "Flat profile : %llu instructions, %llu cycles, %.2f cycles per instruction\n\n",
+            (unsigned long long)tot_inst, (unsigned long long)tot_cycles,
+            (tot_inst) ? (double)tot_cycles / (double)tot_inst : 0.0);
+    fprintf(fh, "%%cycles  cumul%%          cycles    instructions      CPI  address   function\n");
+    cum_cycles = 0;
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        const prof_func_t *f = &list[i];
+        
+        cum_cycles += f->cnt.cycles;
+        fprintf(fh, "%6.2f  %6.2f  %14llu  %14llu  %7.2f  %08X  %s\n",
+                (tot_cycles) ? 100.0 * (double)f->cnt.cycles / (double)tot_cycles : 0.0,
+                (tot_cycles) ? 100.0 * (double)cum_cycles / (double)tot_cycles : 0.0,
+                (unsigned long long)f->cnt.cycles, (unsigned long long)f->cnt.inst,
+                (f->cnt.inst) ? (double)f->cnt.cycles / (double)f->cnt.inst : 0.0,
+                f->addr, f->name);
+    }
+    fclose(fh);
+    
+    printf("Profile : %llu instructions, %llu cycles, %d functions in \"%s\"\n",
+           (unsigned long long)tot_inst, (unsigned long long)tot_cycles, (int)list.size(), name);
+    
+    return 0;
+}
+
+/******************************************************************************/
+/** Write the call graph in the callgrind format (KCachegrind, callgrind_    **/
+/** annotate) : one block per function with the self cost of its addresses   **/
+/** ("positions: instr") and its calls (callee, number of calls, inclusive   **/
+/** cost at the call site). Events : instructions and clock cycles.          **/
+/**   name : callgrind file name                                             **/
+/**   syms : program symbols (NULL : none)                                   **/
+/******************************************************************************/
+int Profiler::writeCallgrind(const char *name, SymTable *syms)
+{
+    std::map<const char *, std::vector<prof_line_t> > funcs;
+    std::vector<std::pair<vluint32_t, const char *> > order;
+    FILE *fh;
+    
+    if ((syms) && (!syms->buildIndex())) syms = NULL;
+    
+    // Self cost of each address, by function
+    for (int i = 0; i < PROF_RAM_WORDS + PROF_ROM_WORDS + 1; i++)
+    {
+        prof_line_t l;
+        
+        if (i < PROF_RAM_WORDS)
+        {
+            l.cnt  = ram_cnt[i];
+            l.addr = 0x80000000 + (i << 2);
+        }
+        else if (i < PROF_RAM_WORDS + PROF_ROM_WORDS)
+        {
+            l.cnt  = rom_cnt[i - PROF_RAM_WORDS];
+            l.addr = (i - PROF_RAM_WORDS) << 2;
+        }
+        else
+        {
+            l.cnt  = other_cnt;
+            l.addr = 0xFFFFFFFF;
+        }
+        if ((!l.cnt.inst) && (!l.cnt.cycles)) continue;
+        
+        l.arc = -1;
+        funcs[func_name((l.addr != 0xFFFFFFFF) ? syms : NULL, l.addr)].push_back(l);
+    }
+    // Calls, in the block of the calling function
+    for (size_t i = 0; i < arcs.size(); i++)
+    {
+        prof_line_t l;
+        
+        l.addr = arcs[i].site;
+        l.arc  = (int)i;
+        funcs[func_name(syms, l.addr)].push_back(l);
+    }
+    
+    // Functions in address order, self cost before the calls
+    for (std::map<const char *, std::vector<prof_line_t> >::iterator it = funcs.begin(); it != funcs.end(); ++it)
+    {
+        std::sort(it->second.begin(), it->second.end(), [](const prof_line_t &a, const prof_line_t &b)
+        {
+            if (a.addr != b.addr) return a.addr < b.addr;
+            return a.arc < b.arc;
+        });
+        order.push_back(std::make_pair(it->second[0].addr, it->first));
+    }
+    std::sort(order.begin(), order.end());
+    
+    fh = fopen(name, "w");
+    if (!fh)
+    {
+        printf("Cannot create callgrind file \"%s\" !\n", name);
+        return -1;
+    }
+    fprintf(fh, "# callgrind format\n");
+    fprintf(fh, "version: 1\n");
+    fprintf(fh, "creator: JiVe Verilator testbench\n");
+    fprintf(fh, "positions: instr\n");
+    fprintf(fh, "events: Ir Cycles\n");
+    fprintf(fh, "summary: %llu %llu\n", (unsigned long long)tot.inst, (unsigned long long)tot.cycles);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const std::vector<prof_line_t> &lines = funcs[order[i].second];
+        
+        fprintf(fh, "\nfn=%s\n", order[i].second);
+        for (size_t j = 0; j < lines.size(); j++)
+        {
+            const prof_line_t *l = &lines[j];
+            
+            if (l->arc < 0)
+            {
+                fprintf(fh, "0x%08X %llu %llu\n", l->addr,
+                        (unsigned long long)l->cnt.inst, (unsigned long long)l->cnt.cycles);
+            }
+            else
+            {
+                const prof_arc_t *a = &arcs[l->arc];
+                
+                fprintf(fh, "cfn=%s\n", func_name(syms, a->target));
+                fprintf(fh, "calls=%llu 0x%08X\n", (unsigned long long)a->calls, a->target);
+                fprintf(fh, "0x%08X %llu %llu\n", a->site,
+                        (unsigned long long)a->incl.inst, (unsigned long long)a->incl.cycles);
+            }
+        }
+    }
+    fclose(fh);
+    
+    printf("Call graph : %d functions, %d call arcs in \"%s\"\n", (int)order.size(), (int)arcs.size(), name);
+    
+    return 0;
+}
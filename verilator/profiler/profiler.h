@@ -0,0 +1,127 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include "verilated.h"
+#include "../sym_table/sym_table.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+// Instructions counted per address : 64 KB RAM @ 0x80000000, 1 KB boot ROM @ 0x00000000
+#define PROF_RAM_WORDS  (16384)
+#define PROF_ROM_WORDS  (256)
+
+// Shadow call stack depth (deeper calls are only counted to match their returns)
+#define PROF_STACK_DEPTH (1024)
+
+// Control flow events of the call graph
+#define PROF_FLOW_NONE  (0)
+#define PROF_FLOW_CALL  (1)     // jal / jalr with rd = ra
+#define PROF_FLOW_RET   (2)     // jalr x0, 0(ra)
+#define PROF_FLOW_TRAP  (3)     // Exception handler entry
+#define PROF_FLOW_MRET  (4)     // Exception / interrupt handler exit
+
+// Counters of one instruction address (or of one function)
+typedef struct
+{
+    vluint64_t  inst;       // Instructions retired
+    vluint64_t  cycles;     // Clock cycles up to the next fetch
+} prof_count_t;
+
+// Call graph arc : call site -> callee, inclusive counters of the callee
+typedef struct
+{
+    vluint32_t   site;      // Call site (faulting / interrupted PC for a handler)
+    vluint32_t   target;    // Callee (handler) entry point
+    vluint64_t   calls;     // Number of calls
+    prof_count_t incl;      // Instructions and cycles up to the return
+} prof_arc_t;
+
+// Shadow call stack frame
+typedef struct
+{
+    int          arc;       // Call graph arc
+    bool         trap;      // Exception / interrupt handler (left by MRET)
+    vluint32_t   ret_pc;    // Return address
+    prof_count_t entry;     // Total counters at the entry
+} prof_frame_t;
+
+// Guest profiler : instructions and clock cycles per fetch address, flat profile by function
+class Profiler
+{
+    public:
+        // Constructor and destructor
+        Profiler(vluint64_t period_ps);
+        ~Profiler();
+        // Instruction fetch (i_rd_ack) : the cycles since the previous one go to the previous address
+        // The call graph event of the previous instruction applies from this fetch
+        inline void fetch(vluint64_t stamp, vluint32_t pc)
+        {
+            if (last_cnt)
+            {
+                vluint64_t cycles = (stamp - last_stamp) / period;
+                
+                last_cnt->cycles += cycles;
+                tot.cycles       += cycles;
+            }
+            if (flow_op != PROF_FLOW_NONE) apply_flow(pc);
+            last_cnt   = get_count(pc);
+            last_pc    = pc;
+            last_stamp = stamp;
+            last_cnt->inst++;
+            tot.inst++;
+        }
+        // Instructions skipped by the idle skip (counted on the last fetch address)
+        inline void skip(vluint64_t num)
+        {
+            if (last_cnt)
+            {
+                last_cnt->inst += num;
+                tot.inst       += num;
+            }
+        }
+        // Call graph event of the instruction just executed (PROF_FLOW_xxx, instruction address)
+        inline void flow(int op, vluint32_t pc)
+        {
+            flow_op = op;
+            flow_pc = pc;
+        }
+        void        interrupt(vluint32_t site);
+        void        stop(vluint64_t stamp);
+        int         writeFlat(const char *name, SymTable *syms);
+        int         writeCallgrind(const char *name, SymTable *syms);
+    private:
+        // Shadow call stack
+        void        apply_flow(vluint32_t pc);
+        void        push_frame(vluint32_t site, vluint32_t target, bool trap, const prof_count_t *entry);
+        void        pop_frame(void);
+        inline prof_count_t *get_count(vluint32_t pc)
+        {
+            if ((pc & 0xFFFF0000) == 0x80000000) return &ram_cnt[(pc >> 2) & (PROF_RAM_WORDS - 1)];
+            if (pc < (PROF_ROM_WORDS << 2))      return &rom_cnt[pc >> 2];
+            return &other_cnt;
+        }
+        // Clock period (in ps)
+        vluint64_t   period;
+        // Counters per instruction address, fetches outside the RAM and the ROM
+        prof_count_t ram_cnt[PROF_RAM_WORDS];
+        prof_count_t rom_cnt[PROF_ROM_WORDS];
+        prof_count_t other_cnt;
+        // Previous fetch (NULL : none yet)
+        prof_count_t *last_cnt;
+        vluint32_t   last_pc;
+        vluint64_t   last_stamp;
+        // Total counters
+        prof_count_t tot;
+        // Call graph event waiting for the next fetch
+        int          flow_op;
+        vluint32_t   flow_pc;
+        // Call graph arcs (index by call site and callee) and shadow call stack
+        std::vector<prof_arc_t> arcs;
+        std::unordered_map<vluint64_t, int> arc_idx;
+        prof_frame_t stack[PROF_STACK_DEPTH];
+        int          stack_num;
+};
+
+#endif /* _PROFILER_H_ */
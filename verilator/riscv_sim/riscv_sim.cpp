@@ -0,0 +1,174 @@
+#include "verilated.h"
+#include "riscv_sim.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Clock cycles per mtime increment (LSOSC.v : CLKLF = _ctr[10], both edges)
+#define RTC_CYCLES      (1024)
+
+// UART/SREC boot ROM contents : Verilator table of jive_bootrom.v (boot_rom.inc,
+// generated by compile.sh)
+static const vluint32_t boot_rom[256] =
+{
+#include "boot_rom.inc"
+};
+
+// Constructor
+RISCVSim::RISCVSim()
+{
+    memset((void *)ram_blk, 0, sizeof(ram_blk));
+    memcpy((void *)rom_blk, (const void *)boot_rom, sizeof(rom_blk));
+    mtime      = (vluint64_t)0;
+    mtimecmp   = (vluint64_t)0xFFFFFFFFFFFFFFFFULL;
+    rtc_cycles = (vluint32_t)0;
+    uart_fh    = NULL;
+}
+
+// Destructor
+RISCVSim::~RISCVSim()
+{
+    if (uart_fh)
+    {
+        fclose(uart_fh);
+    }
+}
+
+// Initialize the 64 KB RAM
+void RISCVSim::loadRam(const vluint8_t *ptr)
+{
+    memcpy((void *)ram_blk, (const void *)ptr, sizeof(ram_blk));
+}
+
+// Replace the UART/SREC boot ROM (1 KB, little endian words)
+void RISCVSim::loadRom(const vluint8_t *ptr)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        rom_blk[i] = ((vluint32_t)ptr[(i << 2) + 0] <<  0) | ((vluint32_t)ptr[(i << 2) + 1] <<  8)
+                   | ((vluint32_t)ptr[(i << 2) + 2] << 16) | ((vluint32_t)ptr[(i << 2) + 3] << 24);
+    }
+}
+
+// UART transmitter log (uart_tx.log for the Verilog model)
+int RISCVSim::openUart(const char *name)
+{
+    uart_fh = fopen(name, "w");
+    
+    return (uart_fh) ? 0 : -1;
+}
+
+// Clock cycles elapsed : machine timer update
+void RISCVSim::advance(vluint32_t cycles)
+{
+    rtc_cycles += cycles;
+    if (rtc_cycles >= RTC_CYCLES)
+    {
+        mtime += (vluint64_t)(rtc_cycles / RTC_CYCLES);
+        rtc_cycles %= RTC_CYCLES;
+    }
+}
+
+// Timer interrupt request (jive_timer.v : mtime > mtimecmp)
+bool RISCVSim::timerInt(void)
+{
+    return (mtime > mtimecmp);
+}
+
+// Machine timer registers (hand-off to the Verilog model)
+void RISCVSim::getTimer(vluint64_t *time, vluint64_t *timecmp)
+{
+    *time    = mtime;
+    *timecmp = mtimecmp;
+}
+
+// 32-bit read, decoded like jive_soc_top.v : { addr[31], addr[17:16] }
+vluint32_t RISCVSim::read(vluint32_t addr)
+{
+    if (addr & 0x80000000)
+    {
+        vluint8_t *p = &ram_blk[addr & 0xFFFC];
+        
+        return ((vluint32_t)p[0] <<  0) | ((vluint32_t)p[1] <<  8)
+             | ((vluint32_t)p[2] << 16) | ((vluint32_t)p[3] << 24);
+    }
+    switch ((addr >> 16) & 3)
+    {
+        // Boot ROM
+        case 0:
+        {
+            return rom_blk[(addr >> 2) & 255];
+        }
+        // Machine timer
+        case 1:
+        {
+            switch (addr & 0xC004)
+            {
+                case 0x4000 : return (vluint32_t)(mtimecmp);
+                case 0x4004 : return (vluint32_t)(mtimecmp >> 32);
+                case 0xC000 : return (vluint32_t)(mtime);
+                case 0xC004 : return (vluint32_t)(mtime >> 32);
+                default     : return (vluint32_t)0;
+            }
+        }
+        // UART : no receiver in standalone mode
+        default:
+        {
+            return (vluint32_t)0;
+        }
+    }
+}
+
+// Masked 32-bit write
+void RISCVSim::write(vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    if (addr & 0x80000000)
+    {
+        vluint8_t *p = &ram_blk[addr & 0xFFFC];
+        
+        if (mask & 1) p[0] = (vluint8_t)(data >>  0);
+        if (mask & 2) p[1] = (vluint8_t)(data >>  8);
+        if (mask & 4) p[2] = (vluint8_t)(data >> 16);
+        if (mask & 8) p[3] = (vluint8_t)(data >> 24);
+        return;
+    }
+    switch ((addr >> 16) & 3)
+    {
+        // Machine timer (32-bit registers)
+        case 1:
+        {
+            switch (addr & 0xC004)
+            {
+                case 0x4000 : mtimecmp = (mtimecmp & 0xFFFFFFFF00000000ULL) | (vluint64_t)data; break;
+                case 0x4004 : mtimecmp = (mtimecmp & 0x00000000FFFFFFFFULL) | ((vluint64_t)data << 32); break;
+                case 0xC000 : mtime    = (mtime    & 0xFFFFFFFF00000000ULL) | (vluint64_t)data; break;
+                case 0xC004 : mtime    = (mtime    & 0x00000000FFFFFFFFULL) | ((vluint64_t)data << 32); break;
+                default     : break;
+            }
+            break;
+        }
+        // UART transmitter
+        case 2:
+        {
+            if ((mask & 1) && (uart_fh))
+            {
+                fputc((int)(data & 0xFF), uart_fh);
+            }
+            break;
+        }
+        // Boot ROM
+        default:
+        {
+            break;
+        }
+    }
+}
+
+// RAM window for the translated blocks (no aliasing)
+vluint8_t *RISCVSim::direct(vluint32_t *base, vluint32_t *size)
+{
+    *base = (vluint32_t)0x80000000;
+    *size = (vluint32_t)sizeof(ram_blk);
+    
+    return ram_blk;
+}
@@ -0,0 +1,39 @@
+#ifndef _RISCV_SIM_H_
+#define _RISCV_SIM_H_
+
+#include "verilated.h"
+#include "../riscv_trace/riscv_trace.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+// Standalone SoC model : boot ROM, machine timer, UART and 64 KB RAM
+class RISCVSim : public RISCVBus
+{
+    public:
+        // Constructor and destructor
+        RISCVSim();
+        ~RISCVSim();
+        // Methods
+        void        loadRam(const vluint8_t *ptr);
+        void        loadRom(const vluint8_t *ptr);
+        int         openUart(const char *name);
+        void        advance(vluint32_t cycles);
+        bool        timerInt(void);
+        void        getTimer(vluint64_t *time, vluint64_t *timecmp);
+        vluint32_t  read(vluint32_t addr);
+        void        write(vluint32_t addr, vluint32_t data, vluint8_t mask);
+        vluint8_t  *direct(vluint32_t *base, vluint32_t *size);
+    private:
+        // 64 KB RAM (0x80000000 - 0x8000FFFF)
+        vluint8_t   ram_blk[65536];
+        // 1 KB boot ROM (0x00000000 - 0x000003FF)
+        vluint32_t  rom_blk[256];
+        // Machine timer (0x00010000 - 0x0001FFFF)
+        vluint64_t  mtime;
+        vluint64_t  mtimecmp;
+        vluint32_t  rtc_cycles;
+        // UART transmitter output
+        FILE       *uart_fh;
+};
+
+#endif /* _RISCV_SIM_H_ */
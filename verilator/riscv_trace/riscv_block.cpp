@@ -0,0 +1,353 @@
+#include "verilated.h"
+#include "riscv_trace.h"
+#include "riscv_isa.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Little endian 32-bit word from the RAM window
+static inline vluint32_t blk_rd32(const vluint8_t *p)
+{
+    return ((vluint32_t)p[0] <<  0) | ((vluint32_t)p[1] <<  8)
+         | ((vluint32_t)p[2] << 16) | ((vluint32_t)p[3] << 24);
+}
+
+// Instructions ending a block : jumps, traps and CSR accesses
+static inline bool blk_end(vluint8_t op)
+{
+    return (op == INS_ILLEGAL) || (op == INS_NONE) || (op == INS_ILL_MEM) || (op >= INS_BEQ);
+}
+
+// Clear the translated blocks (first use or code written)
+void RISCVTrace::blk_flush(void)
+{
+    for (int i = 0; i < BLK_CACHE_SIZE; i++)
+    {
+        blk_cache[i].pc  = (vluint32_t)0xFFFFFFFF;
+        blk_cache[i].len = 0;
+    }
+    memset((void *)blk_code, 0, (blk_ram_size >> BLK_PAGE_BITS) + 1);
+}
+
+// Translate the basic block starting at a PC
+trc_block_t *RISCVTrace::blk_build(RISCVBus *bus, vluint32_t pc)
+{
+    trc_block_t *b;
+    vluint32_t n;
+
+    b = &blk_cache[(pc >> 2) & (BLK_CACHE_SIZE - 1)];
+    b->pc = pc;
+    for (n = 0; n < BLK_MAX_INS; )
+    {
+        trc_dinst_t *d = &b->ins[n].d;
+        vluint32_t addr = pc + (n << 2);
+        vluint32_t offs = addr - blk_ram_base;
+        vluint32_t inst;
+
+        // Instructions in RAM : mark the code page
+        if (offs < blk_ram_size)
+        {
+            inst = blk_rd32(blk_ram + offs);
+            blk_code[offs >> BLK_PAGE_BITS] = 1;
+        }
+        else
+        {
+            inst = bus->read(addr);
+        }
+        riscv_decode(d, inst);
+        d->pc = addr;
+        n++;
+        if (blk_end(d->op)) break;
+    }
+    b->len = n;
+
+    // Block exit : falls through to the next block
+    b->ins[n].d.pc = pc + (n << 2);
+    b->ins[n].d.op = INS_COUNT;
+
+    return b;
+}
+
+/******************************************************************************/
+/** run()                                                                    **/
+/** ------------------------------------------------------------------------ **/
+/** Execute translated basic blocks without Verilog model. Returns after     **/
+/** max_inst instructions, an MMIO access, a CSR access or a dead loop so    **/
+/** that the caller can update the timer and the interrupt request. Also     **/
+/** returns before a block holding stop_pc (the caller steps up to it).      **/
+/**   bus      : memory bus                                                  **/
+/**   tmr_int  : timer interrupt request                                     **/
+/**   max_inst : maximum number of instructions                              **/
+/**   dead     : set on a jump to itself with interrupts disabled            **/
+/**   stop_pc  : PC to reach one instruction at a time (BLK_NO_STOP : none)  **/
+/******************************************************************************/
+
+vluint32_t RISCVTrace::run(RISCVBus *bus, bool tmr_int, vluint32_t max_inst, bool *dead, vluint32_t stop_pc)
+{
+    // Handlers, in INS_xxx order
+    static const void * const lbl_tab[] =
+    {
+        &&h_generic, &&h_nop,   &&h_generic, &&h_generic,
+        &&h_lb,   &&h_lh,   &&h_lw,   &&h_lbu,  &&h_lhu,
+        &&h_sb,   &&h_sh,   &&h_sw,
+        &&h_addi, &&h_slli, &&h_slti, &&h_sltiu,
+        &&h_xori, &&h_srli, &&h_srai, &&h_ori,  &&h_andi,
+        &&h_add,  &&h_sub,  &&h_sll,  &&h_slt,  &&h_sltu,
+        &&h_xor,  &&h_srl,  &&h_sra,  &&h_or,   &&h_and,
+        &&h_lui,  &&h_auipc,
+        &&h_beq,  &&h_bne,  &&h_blt,  &&h_bge,  &&h_bltu, &&h_bgeu,
+        &&h_jalr, &&h_jal,
+        &&h_generic, &&h_generic, &&h_generic,
+        &&h_generic, &&h_generic, &&h_generic,
+        &&h_generic, &&h_generic, &&h_generic,
+        &&h_end
+    };
+    static_assert(sizeof(lbl_tab) / sizeof(lbl_tab[0]) == INS_COUNT + 1, "lbl_tab vs INS_xxx");
+    trc_block_t *b;
+    trc_bins_t *p;
+    vluint32_t count;
+    vluint32_t addr;
+    vluint32_t offs;
+    vluint32_t data;
+    vluint8_t mask;
+    bool stop;
+
+    // First use : RAM window and blocks cache
+    if (!blk_cache)
+    {
+        blk_ram = bus->direct(&blk_ram_base, &blk_ram_size);
+        if (!blk_ram)
+        {
+            blk_ram_base = (vluint32_t)0;
+            blk_ram_size = (vluint32_t)0;
+        }
+        blk_cache = new trc_block_t[BLK_CACHE_SIZE];
+        blk_code  = new vluint8_t[(blk_ram_size >> BLK_PAGE_BITS) + 1];
+        blk_flush();
+    }
+
+    // Timer interrupt
+    riscv_irq(tmr_int);
+
+    *dead = false;
+    count = 0;
+    stop  = false;
+
+    while ((count < max_inst) && (!stop))
+    {
+        // Translated block lookup
+        b = &blk_cache[(pc_reg >> 2) & (BLK_CACHE_SIZE - 1)];
+        if (b->pc != pc_reg)
+        {
+            b = blk_build(bus, pc_reg);
+            for (vluint32_t i = 0; i <= b->len; i++)
+            {
+                b->ins[i].lbl = lbl_tab[b->ins[i].d.op];
+            }
+        }
+        if ((stop_pc != BLK_NO_STOP) && (stop_pc - b->pc < (b->len << 2))) break;
+        p = b->ins;
+        goto *p->lbl;
+
+#define BLK_NEXT        p++; goto *p->lbl
+#define BLK_RS1         gp_regs[p->d.rs1]
+#define BLK_RS2         gp_regs[p->d.rs2]
+#define BLK_WR(val)     if (p->d.rd) gp_regs[p->d.rd] = (val)
+
+        // Register / immediate operations
+    h_addi:  BLK_WR(BLK_RS1 + p->d.imm); BLK_NEXT;
+    h_slli:  BLK_WR(BLK_RS1 << p->d.imm); BLK_NEXT;
+    h_slti:  BLK_WR(((vlsint32_t)BLK_RS1 < (vlsint32_t)p->d.imm) ? 1 : 0); BLK_NEXT;
+    h_sltiu: BLK_WR((BLK_RS1 < p->d.imm) ? 1 : 0); BLK_NEXT;
+    h_xori:  BLK_WR(BLK_RS1 ^ p->d.imm); BLK_NEXT;
+    h_srli:  BLK_WR(BLK_RS1 >> p->d.imm); BLK_NEXT;
+    h_srai:  BLK_WR(SRA_32(BLK_RS1, p->d.imm)); BLK_NEXT;
+    h_ori:   BLK_WR(BLK_RS1 | p->d.imm); BLK_NEXT;
+    h_andi:  BLK_WR(BLK_RS1 & p->d.imm); BLK_NEXT;
+
+        // Register / register operations
+    h_add:   BLK_WR(BLK_RS1 + BLK_RS2); BLK_NEXT;
+    h_sub:   BLK_WR(BLK_RS1 - BLK_RS2); BLK_NEXT;
+    h_sll:   BLK_WR(BLK_RS1 << (BLK_RS2 & 0x1F)); BLK_NEXT;
+    h_slt:   BLK_WR(((vlsint32_t)BLK_RS1 < (vlsint32_t)BLK_RS2) ? 1 : 0); BLK_NEXT;
+    h_sltu:  BLK_WR((BLK_RS1 < BLK_RS2) ? 1 : 0); BLK_NEXT;
+    h_xor:   BLK_WR(BLK_RS1 ^ BLK_RS2); BLK_NEXT;
+    h_srl:   BLK_WR(BLK_RS1 >> (BLK_RS2 & 0x1F)); BLK_NEXT;
+    h_sra:   BLK_WR(SRA_32(BLK_RS1, BLK_RS2 & 0x1F)); BLK_NEXT;
+    h_or:    BLK_WR(BLK_RS1 | BLK_RS2); BLK_NEXT;
+    h_and:   BLK_WR(BLK_RS1 & BLK_RS2); BLK_NEXT;
+
+        // Upper immediate
+    h_lui:   BLK_WR(p->d.imm); BLK_NEXT;
+    h_auipc: BLK_WR(p->d.pc + p->d.imm); BLK_NEXT;
+
+        // FENCE, WFI
+    h_nop:   BLK_NEXT;
+
+        // Loads : RAM window, or MMIO through the bus (block exit)
+    h_lb:
+    h_lbu:
+        addr = BLK_RS1 + p->d.imm;
+        goto ld_word;
+    h_lh:
+    h_lhu:
+        addr = BLK_RS1 + p->d.imm;
+        if (addr & 1) goto ld_error;
+        goto ld_word;
+    h_lw:
+        addr = BLK_RS1 + p->d.imm;
+        if (addr & 3) goto ld_error;
+    ld_word:
+        offs = (addr & 0xFFFFFFFC) - blk_ram_base;
+        if (offs < blk_ram_size)
+        {
+            data = blk_rd32(blk_ram + offs);
+        }
+        else
+        {
+            data = bus->read(addr);
+            stop = true;
+        }
+        data >>= (addr & 3) << 3;
+        switch (p->d.op)
+        {
+            case INS_LB:  data = (GET_BIT(data,7))  ? data | 0xFFFFFF00 : data & 0xFF;   break;
+            case INS_LBU: data = data & 0xFF;                                           break;
+            case INS_LH:  data = (GET_BIT(data,15)) ? data | 0xFFFF0000 : data & 0xFFFF; break;
+            case INS_LHU: data = data & 0xFFFF;                                         break;
+            default:      break;
+        }
+        BLK_WR(data);
+        if (stop)
+        {
+            pc_reg = p->d.pc + 4;
+            goto exit_ins;
+        }
+        BLK_NEXT;
+    ld_error:
+        mem_addr  = addr;
+        except_nr = RAISE_LADDR_ERR;
+        goto trap;
+
+        // Stores : RAM window (code pages flush the blocks), or MMIO through the bus
+    h_sb:
+        addr = BLK_RS1 + p->d.imm;
+        data = (BLK_RS2 & 0xFF) * 0x01010101;
+        mask = (vluint8_t)0x1 << (addr & 3);
+        goto st_word;
+    h_sh:
+        addr = BLK_RS1 + p->d.imm;
+        if (addr & 1) goto st_error;
+        data = (BLK_RS2 & 0xFFFF) * 0x00010001;
+        mask = (vluint8_t)0x3 << (addr & 2);
+        goto st_word;
+    h_sw:
+        addr = BLK_RS1 + p->d.imm;
+        if (addr & 3) goto st_error;
+        data = BLK_RS2;
+        mask = (vluint8_t)0xF;
+    st_word:
+        offs = (addr & 0xFFFFFFFC) - blk_ram_base;
+        sig_write(addr, data, mask);
+        if (offs < blk_ram_size)
+        {
+            vluint8_t *m = blk_ram + offs;
+
+            if (mask & 1) m[0] = (vluint8_t)(data >>  0);
+            if (mask & 2) m[1] = (vluint8_t)(data >>  8);
+            if (mask & 4) m[2] = (vluint8_t)(data >> 16);
+            if (mask & 8) m[3] = (vluint8_t)(data >> 24);
+            if (!blk_code[offs >> BLK_PAGE_BITS])
+            {
+                BLK_NEXT;
+            }
+            // Code modified : translate again
+            blk_flush();
+        }
+        else
+        {
+            bus->write(addr, data, mask);
+            stop = true;
+        }
+        pc_reg = p->d.pc + 4;
+        goto exit_ins;
+    st_error:
+        mem_addr  = addr;
+        except_nr = RAISE_SADDR_ERR;
+        goto trap;
+
+        // Conditional branches
+    h_beq:   if (BLK_RS1 == BLK_RS2) goto br_taken; goto br_not;
+    h_bne:   if (BLK_RS1 != BLK_RS2) goto br_taken; goto br_not;
+    h_blt:   if ((vlsint32_t)BLK_RS1 <  (vlsint32_t)BLK_RS2) goto br_taken; goto br_not;
+    h_bge:   if ((vlsint32_t)BLK_RS1 >= (vlsint32_t)BLK_RS2) goto br_taken; goto br_not;
+    h_bltu:  if (BLK_RS1 <  BLK_RS2) goto br_taken; goto br_not;
+    h_bgeu:  if (BLK_RS1 >= BLK_RS2) goto br_taken; goto br_not;
+    br_not:
+        pc_reg = p->d.pc + 4;
+        goto exit_ins;
+    br_taken:
+        jmp_addr = p->d.pc + p->d.imm;
+        if (jmp_addr & 3) goto jmp_error;
+        goto jmp_done;
+
+        // Jumps
+    h_jalr:
+        addr = (BLK_RS1 + p->d.imm) & 0xFFFFFFFE;
+        BLK_WR(p->d.pc + 4);
+        jmp_addr = addr;
+        if (jmp_addr & 2) goto jmp_error;
+        goto jmp_done;
+    h_jal:
+        BLK_WR(p->d.pc + 4);
+        jmp_addr = p->d.pc + p->d.imm;
+        if (jmp_addr & 3) goto jmp_error;
+    jmp_done:
+        if ((jmp_addr == p->d.pc) && (!(csr_regs[CSR_MIE] & 0x80)))
+        {
+            // Jump to itself : only an interrupt can leave the loop
+            *dead = true;
+            stop  = true;
+        }
+        pc_reg = jmp_addr;
+        goto exit_ins;
+    jmp_error:
+        except_nr = RAISE_IADDR_ERR;
+        goto trap;
+
+        // System, CSR accesses and invalid instructions : reference model
+    h_generic:
+        pc_reg = p->d.pc;
+        riscv_exec(&p->d);
+        if (except_nr != RAISE_NONE)
+        {
+            riscv_trap(p->d.inst);
+        }
+        stop = true;
+        goto exit_ins;
+
+        // Exception on a load, a store or a jump
+    trap:
+        pc_reg = p->d.pc;
+        riscv_trap(p->d.inst);
+        goto exit_ins;
+
+        // Last instruction of the block executed : next block
+    h_end:
+        pc_reg = p->d.pc;
+        count += b->len;
+        continue;
+
+        // Block left on an instruction
+    exit_ins:
+        count += (vluint32_t)(p - b->ins) + 1;
+
+#undef BLK_NEXT
+#undef BLK_RS1
+#undef BLK_RS2
+#undef BLK_WR
+    }
+    inst_cnt += count;
+
+    return count;
+}
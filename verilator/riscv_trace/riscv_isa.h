@@ -0,0 +1,85 @@
+#ifndef _RISCV_ISA_H_
+#define _RISCV_ISA_H_
+
+#include "verilated.h"
+
+// RV32I opcodes (bits 6:0)
+enum
+{
+    OPC_LOAD      = 0x03,
+    OPC_LOAD_FP   = 0x07,
+    OPC_FENCE     = 0x0F,
+    OPC_OP_IMM    = 0x13,
+    OPC_AUIPC     = 0x17,
+    OPC_OP_IMM_32 = 0x1B,
+    OPC_STORE     = 0x23,
+    OPC_STORE_FP  = 0x27,
+    OPC_AMO       = 0x2F,
+    OPC_OP        = 0x33,
+    OPC_LUI       = 0x37,
+    OPC_OP_32     = 0x3B,
+    OPC_MADD      = 0x43,
+    OPC_MSUB      = 0x47,
+    OPC_MMSUB     = 0x4B,
+    OPC_MMADD     = 0x4F,
+    OPC_OP_FP     = 0x53,
+    OPC_BRANCH    = 0x63,
+    OPC_JALR      = 0x67,
+    OPC_JAL       = 0x6F,
+    OPC_SYSTEM    = 0x73
+};
+
+// Arithmetic shift right masks
+static const vluint32_t riscv_sra_table[32] =
+{
+    0x00000000, 0x80000000, 0xC0000000, 0xE0000000,
+    0xF0000000, 0xF8000000, 0xFC000000, 0xFE000000,
+    0xFF000000, 0xFF800000, 0xFFC00000, 0xFFE00000,
+    0xFFF00000, 0xFFF80000, 0xFFFC0000, 0xFFFE0000,
+    0xFFFF0000, 0xFFFF8000, 0xFFFFC000, 0xFFFFE000,
+    0xFFFFF000, 0xFFFFF800, 0xFFFFFC00, 0xFFFFFE00,
+    0xFFFFFF00, 0xFFFFFF80, 0xFFFFFFC0, 0xFFFFFFE0,
+    0xFFFFFFF0, 0xFFFFFFF8, 0xFFFFFFFC, 0xFFFFFFFE
+};
+
+#define GET_BIT(A,N)    (((A) >> N) & 1)
+#define SRA_32(A,N)     (((A) & 0x80000000) ? ((A) >> (N)) | riscv_sra_table[(N)] : ((A) >> (N)))
+
+#define XFER_NONE       ((vluint8_t)0xFF)
+#define XFER_LB         ((vluint8_t)0x00)
+#define XFER_LH         ((vluint8_t)0x01)
+#define XFER_LW         ((vluint8_t)0x02)
+#define XFER_LBU        ((vluint8_t)0x04)
+#define XFER_LHU        ((vluint8_t)0x05)
+#define XFER_SB         ((vluint8_t)0x08)
+#define XFER_SH         ((vluint8_t)0x09)
+#define XFER_SW         ((vluint8_t)0x0A)
+
+#define RAISE_NONE      ((vluint32_t)0xFFFFFFFF)
+#define RAISE_IADDR_ERR ((vluint32_t)0x00000000)
+#define RAISE_ILLEGAL   ((vluint32_t)0x00000002)
+#define RAISE_EBREAK    ((vluint32_t)0x00000003)
+#define RAISE_LADDR_ERR ((vluint32_t)0x00000004)
+#define RAISE_SADDR_ERR ((vluint32_t)0x00000006)
+#define RAISE_ECALL     ((vluint32_t)0x0000000B)
+
+#define RAISE_SOFT_INT  ((vluint32_t)0x80000003)
+#define RAISE_TIMER_INT ((vluint32_t)0x80000007)
+#define RAISE_EXT_INT   ((vluint32_t)0x8000000B)
+
+#define CSR_UTVEC       (0x005)
+#define CSR_UEPC        (0x041)
+#define CSR_UCAUSE      (0x042)
+#define CSR_UTVAL       (0x043)
+#define CSR_STVEC       (0x105)
+#define CSR_SEPC        (0x141)
+#define CSR_SCAUSE      (0x142)
+#define CSR_STVAL       (0x143)
+#define CSR_MIE         (0x304)
+#define CSR_MTVEC       (0x305)
+#define CSR_MEPC        (0x341)
+#define CSR_MCAUSE      (0x342)
+#define CSR_MTVAL       (0x343)
+#define CSR_MIP         (0x344)
+
+#endif /* _RISCV_ISA_H_ */
@@ -1,32 +1,11 @@
 #include "verilated.h"
 #include "riscv_trace.h"
+#include "riscv_isa.h"
 #include <stdlib.h>
 #include <stdio.h>
-
-enum
-{
-    OPC_LOAD      = 0x03,
-    OPC_LOAD_FP   = 0x07,
-    OPC_FENCE     = 0x0F,
-    OPC_OP_IMM    = 0x13,
-    OPC_AUIPC     = 0x17,
-    OPC_OP_IMM_32 = 0x1B,
-    OPC_STORE     = 0x23,
-    OPC_STORE_FP  = 0x27,
-    OPC_AMO       = 0x2F,
-    OPC_OP        = 0x33,
-    OPC_LUI       = 0x37,
-    OPC_OP_32     = 0x3B,
-    OPC_MADD      = 0x43,
-    OPC_MSUB      = 0x47,
-    OPC_MMSUB     = 0x4B,
-    OPC_MMADD     = 0x4F,
-    OPC_OP_FP     = 0x53,
-    OPC_BRANCH    = 0x63,
-    OPC_JALR      = 0x67,
-    OPC_JAL       = 0x6F,
-    OPC_SYSTEM    = 0x73
-};
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
 
 // Hexadecimal conversion table
 static const char hex_dig[16] =
@@ -161,75 +140,173 @@ static const char csr_str[216][16] =
     "mhartid",        "csrF15",         "csrF16",         "csrF17"
 };
 
-static const vluint32_t riscv_sra_table[32] =
+
+// Lockstep mismatch kinds
+enum
+{
+    MIS_WB_INDEX   = 0,
+    MIS_WB_DATA    = 1,
+    MIS_INST_ADDR  = 2,
+    MIS_DATA_ADDR  = 3,
+    MIS_DATA_XFER  = 4,
+    MIS_DATA_VALUE = 5,
+    MIS_DATA_MASK  = 6
+};
+
+static const char mismatch_str[7][20] =
 {
-    0x00000000, 0x80000000, 0xC0000000, 0xE0000000,
-    0xF0000000, 0xF8000000, 0xFC000000, 0xFE000000,
-    0xFF000000, 0xFF800000, 0xFFC00000, 0xFFE00000,
-    0xFFF00000, 0xFFF80000, 0xFFFC0000, 0xFFFE0000,
-    0xFFFF0000, 0xFFFF8000, 0xFFFFC000, 0xFFFFE000,
-    0xFFFFF000, 0xFFFFF800, 0xFFFFFC00, 0xFFFFFE00,
-    0xFFFFFF00, 0xFFFFFF80, 0xFFFFFFC0, 0xFFFFFFE0,
-    0xFFFFFFF0, 0xFFFFFFF8, 0xFFFFFFFC, 0xFFFFFFFE
+    "WRITEBACK INDEX", "WRITEBACK DATA", "INST ADDRESS", "DATA ADDRESS",
+    "DATA TRANSFER TYPE", "DATA VALUE", "DATA MASK"
 };
 
-#define GET_BIT(A,N)    (((A) >> N) & 1)
-#define SRA_32(A,N)     (((A) & 0x80000000) ? ((A) >> (N)) | riscv_sra_table[(N)] : ((A) >> (N)))
-
-#define XFER_NONE       ((vluint8_t)0xFF)
-#define XFER_LB         ((vluint8_t)0x00)
-#define XFER_LH         ((vluint8_t)0x01)
-#define XFER_LW         ((vluint8_t)0x02)
-#define XFER_LBU        ((vluint8_t)0x04)
-#define XFER_LHU        ((vluint8_t)0x05)
-#define XFER_SB         ((vluint8_t)0x08)
-#define XFER_SH         ((vluint8_t)0x09)
-#define XFER_SW         ((vluint8_t)0x0A)
-
-#define RAISE_NONE      ((vluint32_t)0xFFFFFFFF)
-#define RAISE_IADDR_ERR ((vluint32_t)0x00000000)
-#define RAISE_ILLEGAL   ((vluint32_t)0x00000002)
-#define RAISE_EBREAK    ((vluint32_t)0x00000003)
-#define RAISE_LADDR_ERR ((vluint32_t)0x00000004)
-#define RAISE_SADDR_ERR ((vluint32_t)0x00000006)
-#define RAISE_ECALL     ((vluint32_t)0x0000000B)
-
-#define RAISE_SOFT_INT  ((vluint32_t)0x80000003)
-#define RAISE_TIMER_INT ((vluint32_t)0x80000007)
-#define RAISE_EXT_INT   ((vluint32_t)0x8000000B)
-
-#define CSR_UTVEC       (0x005)
-#define CSR_UEPC        (0x041)
-#define CSR_UCAUSE      (0x042)
-#define CSR_UTVAL       (0x043)
-#define CSR_STVEC       (0x105)
-#define CSR_SEPC        (0x141)
-#define CSR_SCAUSE      (0x142)
-#define CSR_STVAL       (0x143)
-#define CSR_MTVEC       (0x305)
-#define CSR_MEPC        (0x341)
-#define CSR_MCAUSE      (0x342)
-#define CSR_MTVAL       (0x343)
+// Binary trace format :
+// =====================
+// Header : "JIVETRC1" magic (8 bytes), reset vector (4 bytes)
+// Record : tag (1 byte), time stamp delta in ps (LEB128, except for
+//          BIN_TAG_REG records), payload (little endian)
+#define BIN_MAGIC        "JIVETRC1"
+#define BIN_TAG_FETCH    ((vluint8_t)0x01) // PC (4), instruction (4)
+#define BIN_TAG_FETCH_S  ((vluint8_t)0x02) // instruction (4), PC = previous PC + 4
+#define BIN_TAG_REG      ((vluint8_t)0x03) // index (1), value (4)
+#define BIN_TAG_MEM_RD   ((vluint8_t)0x04) // address (4), data (4)
+#define BIN_TAG_MEM_WR   ((vluint8_t)0x05) // address (4), byte enable (1), data (4)
+#define BIN_TAG_MISMATCH ((vluint8_t)0x06) // kind (1), Verilog value (4), C-Model value (4)
+#define BIN_TAG_FETCH_D  ((vluint8_t)0x07) // PC (4), instruction (4), C-Model PC (4)
+
+// Read one byte from a binary trace (end of file : *trunc set)
+static int fget8(gzFile fh, bool *trunc)
+{
+    int ch = gzgetc(fh);
+    
+    if (ch < 0)
+    {
+        *trunc = true;
+        return 0;
+    }
+    return ch;
+}
+
+// Read a little endian 32-bit value from a binary trace (end of file : *trunc set)
+static vluint32_t fget32(gzFile fh, bool *trunc)
+{
+    vluint32_t val;
+    
+    val  = (vluint32_t)fget8(fh, trunc) <<  0;
+    val |= (vluint32_t)fget8(fh, trunc) <<  8;
+    val |= (vluint32_t)fget8(fh, trunc) << 16;
+    val |= (vluint32_t)fget8(fh, trunc) << 24;
+    
+    return val;
+}
+
+// Read a LEB128 encoded value from a binary trace (end of file : *trunc set)
+static vluint64_t fgetleb(gzFile fh, bool *trunc)
+{
+    vluint64_t val = 0;
+    int shift = 0;
+    int ch;
+    
+    do
+    {
+        ch = gzgetc(fh);
+        if (ch < 0)
+        {
+            *trunc = true;
+            break;
+        }
+        val |= (vluint64_t)(ch & 0x7F) << shift;
+        shift += 7;
+    }
+    while (ch & 0x80);
+    
+    return val;
+}
 
 // Constructor
 RISCVTrace::RISCVTrace(vluint32_t reset_vect, vluint32_t comp_data_beg, vluint32_t comp_data_end)
 {
     // Initialize PC
     pc_reg = reset_vect & 0xFFFFFFFC;
-    // Clear registers
-    for (int i = 0; i < 16; i++)
+    // Text trace by default
+    trc_fmt     = TRC_FMT_TEXT;
+    curr_stamp  = (vluint64_t)0;
+    // Binary trace : registers shadow cleared
+    bin_stamp   = (vluint64_t)0;
+    bin_pc      = pc_reg - 4;
+    bin_len     = 0;
+    for (int i = 0; i < 32; i++)
+    {
+        bin_gp_regs[i] = (vluint32_t)0;
+    }
+    // Clear registers (x0 - x31)
+    for (int i = 0; i < 32; i++)
     {
         gp_regs[i] = (vluint32_t)0;
     }
     // Files handles set to STDOUT
+    bname[0]    = (char)0;
     tname[0]    = (char)0;
     oname[0]    = (char)0;
     tfh         = stdout;
     ofh         = stdout;
+    // No segments, no compression
+    tgz         = NULL;
+    mfh         = NULL;
+    seg_limit   = (vluint64_t)0;
+    seg_num     = 0;
+    gz_level    = 0;
+    seg_bytes   = (vluint64_t)0;
+    seg_fetch   = (vluint64_t)0;
+    seg_min_pc  = (vluint32_t)0xFFFFFFFF;
+    seg_max_pc  = (vluint32_t)0x00000000;
+    // No trigger : capture everything from reset
+    for (int i = 0; i < 2; i++)
+    {
+        trg_type[i]  = TRG_NONE;
+        trg_value[i] = (vluint64_t)0;
+        trg_fired[i] = false;
+    }
+    capture     = true;
+    inst_cnt    = (vluint64_t)0;
+    // No history
+    hist_buf    = NULL;
+    hist_size   = 0;
+    hist_cnt    = 0;
+    hist_idx    = 0;
+    // No fail-fast
+    fname[0]    = (char)0;
+    fail_buf    = NULL;
+    fail_size   = 0;
+    fail_cnt    = 0;
+    fail_idx    = 0;
+    fail_hit.store(false);
+    halt_hit.store(false);
+    // No worker thread
+    worker      = NULL;
+    smp_ring    = NULL;
+    smp_size    = 0;
+    // No symbols
+    sym_tab     = NULL;
+    // No profiler
+    prof        = NULL;
+    // Disassembly cache cleared (PC tags are never odd)
+    for (int i = 0; i < DASM_CACHE_SIZE; i++)
+    {
+        dasm_cache[i].pc = (vluint32_t)0xFFFFFFFF;
+    }
+    // Decoded instructions cache cleared
+    for (int i = 0; i < DEC_CACHE_SIZE; i++)
+    {
+        dec_cache[i].pc = (vluint32_t)0xFFFFFFFF;
+    }
+    // No translated blocks yet (standalone simulation only)
+    blk_cache   = NULL;
+    blk_code    = NULL;
+    blk_ram     = NULL;
     // Internal variables cleared
-    dasm_buf[0] = (char)0;
     prev_clk    = (vluint8_t)0;
     except_nr   = RAISE_NONE;
+    isr_on      = false;
     mem_xfer    = XFER_NONE;
     mem_mask    = (vluint8_t)0xF;
     mem_addr    = (vluint32_t)0x00000000;
@@ -257,40 +334,165 @@ RISCVTrace::~RISCVTrace()
         delete[] test_ptr;
         test_ptr = NULL;
     }
+    
+    if (hist_buf)
+    {
+        delete[] hist_buf;
+        hist_buf = NULL;
+    }
+    
+    if (fail_buf)
+    {
+        delete[] fail_buf;
+        fail_buf = NULL;
+    }
+    
+    if (blk_cache)
+    {
+        delete[] blk_cache;
+        delete[] blk_code;
+        blk_cache = NULL;
+        blk_code  = NULL;
+    }
+}
+
+// Select trace file format (before open)
+void RISCVTrace::setFormat(int fmt)
+{
+    trc_fmt = (fmt == TRC_FMT_BIN) ? TRC_FMT_BIN : TRC_FMT_TEXT;
+}
+
+// Set a trace capture trigger (TRG_START or TRG_STOP)
+void RISCVTrace::setTrigger(int idx, int type, vluint64_t value)
+{
+    idx &= 1;
+    trg_type[idx]  = type;
+    trg_value[idx] = value;
+    trg_fired[idx] = false;
+    
+    // Wait for the start trigger
+    if (idx == TRG_START)
+    {
+        capture = (type == TRG_NONE) ? true : false;
+    }
+}
+
+// Keep the last instructions executed before the start trigger
+void RISCVTrace::setHistory(int depth)
+{
+    if (hist_buf)
+    {
+        delete[] hist_buf;
+        hist_buf = NULL;
+    }
+    hist_size = (depth > 0) ? depth : 0;
+    hist_cnt  = 0;
+    hist_idx  = 0;
+    if (hist_size)
+    {
+        hist_buf = new trc_hist_t[hist_size];
+    }
+}
+
+// Stop at the first mismatch : report file name and last instructions kept
+void RISCVTrace::setFailFast(const char *name, int depth)
+{
+    if (fail_buf)
+    {
+        delete[] fail_buf;
+        fail_buf = NULL;
+    }
+    strncpy(fname, name, 255);
+    fname[255] = (char)0;
+    fail_size = (depth > 0) ? depth : 1;
+    fail_cnt  = 0;
+    fail_idx  = 0;
+    fail_buf  = new trc_hist_t[fail_size];
+    fail_hit.store(false);
+}
+
+// Program symbols : "<func+offset>" in the disassembly and the text trace
+// (NULL : addresses only, the table must outlive the trace)
+void RISCVTrace::setSymbols(SymTable *syms)
+{
+    sym_tab = NULL;
+    if ((syms) && (syms->buildIndex())) sym_tab = syms;
+    
+    // Disassembly cache cleared
+    for (int i = 0; i < DASM_CACHE_SIZE; i++)
+    {
+        dasm_cache[i].pc = (vluint32_t)0xFFFFFFFF;
+    }
+}
+
+// True once a mismatch has been reported in fail-fast mode
+bool RISCVTrace::failed(void)
+{
+    return fail_hit.load(std::memory_order_acquire);
+}
+
+// True once the Verilog model loops on a jump to itself (end of test)
+bool RISCVTrace::halted(void)
+{
+    return halt_hit.load(std::memory_order_acquire);
+}
+
+// Rotate the trace file when a segment reaches a size (0 : no rotation)
+void RISCVTrace::setSegmentSize(vluint64_t max_bytes)
+{
+    seg_limit = max_bytes;
+}
+
+// Compress the trace segments with zlib (0 : no compression, 1 - 9)
+void RISCVTrace::setCompression(int level)
+{
+    gz_level = (level < 0) ? 0 : (level > 9) ? 9 : level;
 }
 
 // Open trace file
 int RISCVTrace::open(const char *name)
 {
-    FILE *fh;
-    
     // Close previous file
     this->close();
-
-    // Complete the trace file name
-    //strncpy(tname, name, 246);
-    //strcat(tname, "_0000.trc");
-    strncpy(tname, name, 249);
-    strcat(tname, ".out32");
     
-    // Try to open the trace file for writing
-    fh = fopen(tname, "w");
-    if (!fh)
+    // Base name for the trace segments
+    strncpy(bname, name, 200);
+    bname[200] = (char)0;
+    seg_num = 0;
+    
+    // Segments manifest
+    if (seg_limit)
+    {
+        char mname[256];
+        
+        sprintf(mname, "%s.manifest", bname);
+        mfh = fopen(mname, "w");
+        if (mfh)
+        {
+            fprintf(mfh, "# segment first_ps last_ps min_pc max_pc\n");
+        }
+    }
+    
+    // First trace segment
+    if (open_segment())
     {
-        // Failure
-        tname[0] = (char)0;
         return -1;
     }
-    // Success
-    tfh = fh;
+    
+    return openSignature(name);
+}
+
+// Open signature file only : <name>_signature.output
+int RISCVTrace::openSignature(const char *name)
+{
+    FILE *fh;
     
     // Complete the output file name
-    //strncpy(oname, name, 246);
-    //strcat(oname, "_0000.out");
     strncpy(oname, name, 238);
+    oname[238] = (char)0;
     strcat(oname, "_signature.output");
     
-    // Try to open the trace file for writing
+    // Try to open the signature file for writing
     fh = fopen(oname, "w");
     if (!fh)
     {
@@ -304,244 +506,1392 @@ int RISCVTrace::open(const char *name)
     return 0;
 }
 
-// Open next trace & output files
+// Open next trace segment
 int RISCVTrace::openNext(void)
 {
-    FILE *fh;
-    int len;
-
-    // Close previous file
-    this->close();
+    if (!bname[0]) return -1;
+    
+    close_segment();
+    seg_num++;
+    
+    return open_segment();
+}
 
-    // Get filename length
-    len = strlen(tname);
-    if (!len) return -1;
+// Open the current trace segment : <name>[_<num>].out32/.trc32[.gz]
+int RISCVTrace::open_segment(void)
+{
+    char num[8];
     
-    // Increment the trace file name
-    /*
-    if (tname[len-5] == '9')
+    // Complete the trace file name (numbered when rotated)
+    if ((seg_limit) || (seg_num))
     {
-        tname[len-5] = '0';
-        if (tname[len-6] == '9')
-        {
-            tname[len-6] = '0';
-            if (tname[len-7] == '9')
-            {
-                tname[len-7] = '0';
-                tname[len-8]++;
-            }
-            else
-            {
-                tname[len-7]++;
-            }
-        }
-        else
-        {
-            tname[len-6]++;
-        }
+        sprintf(num, "_%04d", seg_num % 10000);
     }
     else
     {
-        tname[len-5]++;
+        num[0] = (char)0;
     }
-    */
+    snprintf(tname, sizeof(tname), "%s%s%s%s", bname, num,
+            (trc_fmt == TRC_FMT_BIN) ? ".trc32" : ".out32",
+            (gz_level) ? ".gz" : "");
     
     // Try to open the trace file for writing
-    fh = fopen(tname, "w");
-    if (!fh)
+    if (gz_level)
+    {
+        char mode[4] = { 'w', 'b', (char)('0' + gz_level), (char)0 };
+        
+        tgz = gzopen(tname, mode);
+        if (tgz)
+        {
+            gzbuffer(tgz, 1 << 18);
+        }
+    }
+    else
+    {
+        tfh = fopen(tname, (trc_fmt == TRC_FMT_BIN) ? "wb" : "w");
+        if (tfh)
+        {
+            setvbuf(tfh, NULL, _IOFBF, 1 << 20);
+        }
+        else
+        {
+            tfh = stdout;
+        }
+    }
+    if ((tfh == stdout) && (!tgz))
     {
         // Failure
         tname[0] = (char)0;
         return -1;
     }
-    // Success
-    tfh = fh;
     
-    // Increment the output file name
-    /*
-    oname[len-5] = tname[len-5];
-    oname[len-6] = tname[len-6];
-    oname[len-7] = tname[len-7];
-    oname[len-8] = tname[len-8];
-    */
+    // Segment range
+    seg_bytes  = (vluint64_t)0;
+    seg_fetch  = (vluint64_t)0;
+    seg_beg_ps = (vluint64_t)0;
+    seg_end_ps = (vluint64_t)0;
+    seg_min_pc = (vluint32_t)0xFFFFFFFF;
+    seg_max_pc = (vluint32_t)0x00000000;
     
-    // Try to open the output file for writing
-    fh = fopen(oname, "w");
-    if (!fh)
+    // Binary records header, the segment does not depend on the previous one
+    if (trc_fmt == TRC_FMT_BIN)
     {
-        // Failure
-        oname[0] = (char)0;
-        return -1;
+        bin_stamp = (vluint64_t)0;
+        for (int i = 0; i < 32; i++)
+        {
+            bin_gp_regs[i] = (vluint32_t)0;
+        }
+        bin_header();
     }
-    // Success
-    ofh = fh;
     
     return 0;
 }
 
-// Close trace file
-void RISCVTrace::close(void)
+// Close the current trace segment and record its range in the manifest
+void RISCVTrace::close_segment(void)
 {
+    if (tgz)
+    {
+        gzclose(tgz);
+        tgz = NULL;
+    }
     if (tfh != stdout)
     {
         fclose(tfh);
         tfh = stdout;
     }
+    if ((mfh) && (tname[0]))
+    {
+        if (seg_fetch)
+        {
+            fprintf(mfh, "%s %llu %llu %08X %08X\n", tname,
+                    seg_beg_ps, seg_end_ps, seg_min_pc, seg_max_pc);
+        }
+        else
+        {
+            fprintf(mfh, "%s - - - -\n", tname);
+        }
+        fflush(mfh);
+    }
+    tname[0] = (char)0;
+}
+
+// Write into the current trace segment
+void RISCVTrace::trc_write(const char *buf, int len)
+{
+    if (tgz)
+    {
+        gzwrite(tgz, buf, (unsigned)len);
+    }
+    else
+    {
+        fwrite(buf, 1, len, tfh);
+    }
+    seg_bytes += (vluint64_t)len;
+}
+
+// Close trace file
+void RISCVTrace::close(void)
+{
+    // Process the pending samples first
+    this->stopWorker();
+    
+    // Last trace segment
+    close_segment();
+    if (mfh)
+    {
+        fclose(mfh);
+        mfh = NULL;
+    }
+    bname[0] = (char)0;
+    
     if (ofh != stdout)
     {
+        static const char sig_dig[17] = "0123456789abcdef";
+        
+        // 16 bytes per line, MSB first
         for (vluint32_t i = 0; i < test_size; i = i + 16)
         {
-            fprintf(ofh, "%02x", test_ptr[i+0xF]);
-            fprintf(ofh, "%02x", test_ptr[i+0xE]);
-            fprintf(ofh, "%02x", test_ptr[i+0xD]);
-            fprintf(ofh, "%02x", test_ptr[i+0xC]);
-            fprintf(ofh, "%02x", test_ptr[i+0xB]);
-            fprintf(ofh, "%02x", test_ptr[i+0xA]);
-            fprintf(ofh, "%02x", test_ptr[i+0x9]);
-            fprintf(ofh, "%02x", test_ptr[i+0x8]);
-            fprintf(ofh, "%02x", test_ptr[i+0x7]);
-            fprintf(ofh, "%02x", test_ptr[i+0x6]);
-            fprintf(ofh, "%02x", test_ptr[i+0x5]);
-            fprintf(ofh, "%02x", test_ptr[i+0x4]);
-            fprintf(ofh, "%02x", test_ptr[i+0x3]);
-            fprintf(ofh, "%02x", test_ptr[i+0x2]);
-            fprintf(ofh, "%02x", test_ptr[i+0x1]);
-            fprintf(ofh, "%02x", test_ptr[i+0x0]);
-            fprintf(ofh, "\n");
+            char line[34];
+            
+            for (int j = 0; j < 16; j++)
+            {
+                line[(j << 1) + 0] = sig_dig[test_ptr[i + 15 - j] >> 4];
+                line[(j << 1) + 1] = sig_dig[test_ptr[i + 15 - j] & 15];
+            }
+            line[32] = '\n';
+            line[33] = (char)0;
+            fputs(line, ofh);
         }
         fclose(ofh);
         ofh = stdout;
     }
 }
 
-// Dump trace
-void RISCVTrace::dump
-(
-    vluint64_t stamp,
-    // Clock
-    vluint8_t  clk,
-    // Instruction fetch
-    vluint8_t  i_rd_ack,
-    vluint32_t i_address,
-    vluint32_t i_rddata,
-    // Data read/write
-    vluint8_t  d_rd_ack,
-    vluint8_t  d_wr_ack,
-    vluint32_t d_address,
-    vluint8_t  d_byteena,
-    vluint32_t d_rddata,
-    vluint32_t d_wrdata,
-    // Interrupt Receiver
-    vluint32_t inr_ir_irq,
-    // Register write-back
-    vluint8_t  wb_ena,
-    vluint8_t  wb_idx,
-    vluint32_t wb_data
-)
+// Hexadecimal digit value
+static inline int hex_val(char c)
 {
-    // Rising edge on clock
-    if (clk && !prev_clk)
+    return (c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+// Compare the signature with a reference file (hexadecimal lines, MSB first)
+// Returns 0 when they match, 1 when they differ, -1 on a file error
+int RISCVTrace::compareSignature(const char *name)
+{
+    FILE       *fh;
+    vluint8_t  *ref;
+    vluint32_t  ref_size;
+    vluint32_t  errors;
+    char        line[256];
+    
+    fh = fopen(name, "r");
+    if (!fh)
+    {
+        printf("Cannot open reference signature \"%s\" !\n", name);
+        return -1;
+    }
+    
+    // Reference bytes, LSB first
+    ref = new vluint8_t[test_size + 16];
+    ref_size = 0;
+    while (fgets(line, sizeof(line), fh))
     {
-        //ip_reg = ip_reg | inr_ir_irq & im_reg;
-        if (wb_ena)
+        int len = 0;
+        
+        while (isxdigit(line[len])) len++;
+        for (int i = len - 2; i >= 0; i -= 2)
         {
-            if (wb_idx != rd_idx)
-            {
-                fprintf(tfh, "!!! WRITEBACK INDEX MISMATCH !!!\n");
-                fprintf(tfh, "Verilog : %2d, C-Model : %2d\n", wb_idx, rd_idx);
-            }
-            else if ((gp_regs[rd_idx] != wb_data) && (rd_idx))
+            if (ref_size < test_size + 16)
             {
-                fprintf(tfh, "!!! WRITEBACK DATA MISMATCH !!!\n");
-                fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", wb_data, gp_regs[rd_idx]);
+                ref[ref_size] = (vluint8_t)((hex_val(line[i]) << 4) | hex_val(line[i+1]));
             }
+            ref_size++;
         }
-        if (d_rd_ack)
-        {
-            fprintf(tfh, "Memory read @ $%08X : %08X\n", d_address, d_rddata);
-            
-            // Instruction simulation (memory/writeback)
-            riscv_simu_rd(d_address, d_rddata);
-        }
-        if (d_wr_ack)
+    }
+    fclose(fh);
+    
+    // Compare 32-bit words
+    errors = 0;
+    if (ref_size != test_size)
+    {
+        printf("Signature is %u bytes, reference \"%s\" is %u bytes\n", test_size, name, ref_size);
+        errors++;
+    }
+    for (vluint32_t i = 0; (i + 4 <= test_size) && (i + 4 <= ref_size); i += 4)
+    {
+        if (memcmp(test_ptr + i, ref + i, 4))
         {
-            char buf[10];
-            
-            memcpy(buf + 6, (d_byteena & 1) ? uhex_to_str(d_wrdata >>  0, 2) : "$XX", 3);
-            memcpy(buf + 4, (d_byteena & 2) ? uhex_to_str(d_wrdata >>  8, 2) : "$XX", 3);
-            memcpy(buf + 2, (d_byteena & 4) ? uhex_to_str(d_wrdata >> 16, 2) : "$XX", 3);
-            memcpy(buf + 0, (d_byteena & 8) ? uhex_to_str(d_wrdata >> 24, 2) : "$XX", 3);
-            buf[9] = (char)0;
-            
-            fprintf(tfh, "Memory write @ $%08X : %s\n", d_address, buf);
-            
-            if ((test_ptr) && (d_address >= test_start) && (d_address < test_stop))
+            if (errors < 16)
             {
-                vluint32_t offs = (d_address & 0xFFFFFFFC) - test_start;
-                if (d_byteena & 1) test_ptr[offs+0] = (vluint8_t)(d_wrdata >> 0);
-                if (d_byteena & 2) test_ptr[offs+1] = (vluint8_t)(d_wrdata >> 8);
-                if (d_byteena & 4) test_ptr[offs+2] = (vluint8_t)(d_wrdata >> 16);
-                if (d_byteena & 8) test_ptr[offs+3] = (vluint8_t)(d_wrdata >> 24);
+                printf("Signature @ %08X : %02x%02x%02x%02x, expected %02x%02x%02x%02x\n", test_start + i,
+                       test_ptr[i+3], test_ptr[i+2], test_ptr[i+1], test_ptr[i+0],
+                       ref[i+3], ref[i+2], ref[i+1], ref[i+0]);
             }
-            
-            // Instruction simulation (memory)
-            riscv_simu_wr(d_address, d_wrdata, d_byteena);
-        }
-        if (i_rd_ack)
-        {
-            char buf[80];
-            
-            // CPU registers
-            fprintf(tfh, " x0 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[ 0], gp_regs[ 1], gp_regs[ 2], gp_regs[ 3],
-                    gp_regs[ 4], gp_regs[ 5], gp_regs[ 6], gp_regs[ 7]
-                   );
-            fprintf(tfh, " x8 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[ 8], gp_regs[ 9], gp_regs[10], gp_regs[11],
-                    gp_regs[12], gp_regs[13], gp_regs[14], gp_regs[15]
-                   );
-            fprintf(tfh, "x16 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
-                    gp_regs[16], gp_regs[17], gp_regs[18], gp_regs[19],
-                    gp_regs[20], gp_regs[21], gp_regs[22], gp_regs[23]
-                   );
-            fprintf(tfh, "x24 : %08X %08X %08X %08X %08X %08X %08X %08X\n\n",
-                    gp_regs[24], gp_regs[25], gp_regs[26], gp_regs[27],
-                    gp_regs[28], gp_regs[29], gp_regs[30], gp_regs[31]
-                   );
-                   
-            // Disassemble instruction being fetched
-            riscv_dasm(buf, i_rddata, pc_reg);
-            fprintf(tfh, "(%14llu ps) %08X : %08X %s\n", stamp, i_address, i_rddata, buf);
-            
-            // Instruction simulation (fetch/decode/execute/writeback)
-            riscv_simu_if(i_address, i_rddata);
+            errors++;
         }
     }
-    prev_clk = clk;
+    delete[] ref;
+    
+    return (errors) ? 1 : 0;
 }
 
-// Disassemble one instruction
-char RISCVTrace::disasm(vluint32_t inst, vluint32_t pc, int idx)
+// Save the ISS state and the outputs positions into a checkpoint
+void RISCVTrace::save(VerilatedSerialize &os)
 {
-    if (idx == 0)
+    vluint32_t ring = smp_size;
+    bool       async = (worker) ? true : false;
+    long       mpos;
+    
+    // Process the pending samples first
+    this->stopWorker();
+    
+    // The trace continues in a new segment after the checkpoint
+    if (bname[0])
     {
-        memset(dasm_buf, 0, 32);
-        riscv_dasm(dasm_buf, inst, pc);
+        openNext();
     }
-    return dasm_buf[idx & 31];
-}
-
-/******************************************************************************/
-/** uhex_to_str()                                                            **/
-/** ------------------------------------------------------------------------ **/
-/** Convert an unsigned 32-bit value into a hexadecimal string               **/
-/**   val : 32-bit value                                                     **/
-/**   dig : number of hexadecimal digits (1 - 8)                             **/
+    
+    // C-Model state
+    os.write(gp_regs, sizeof(gp_regs));
+    os.write(&pc_reg, sizeof(pc_reg));
+    os.write(csr_regs, sizeof(csr_regs));
+    os.write(&isr_on, sizeof(isr_on));
+    os.write(&except_nr, sizeof(except_nr));
+    os.write(&inst_cnt, sizeof(inst_cnt));
+    os.write(&curr_stamp, sizeof(curr_stamp));
+    os.write(&prev_clk, sizeof(prev_clk));
+    os.write(&rd_idx, sizeof(rd_idx));
+    os.write(&mem_xfer, sizeof(mem_xfer));
+    os.write(&mem_mask, sizeof(mem_mask));
+    os.write(&mem_addr, sizeof(mem_addr));
+    os.write(&mem_data, sizeof(mem_data));
+    os.write(&jmp_addr, sizeof(jmp_addr));
+    os.write(&bin_pc, sizeof(bin_pc));
+    
+    // Compliance tests results
+    os.write(&test_size, sizeof(test_size));
+    if (test_size) os.write(test_ptr, test_size);
+    
+    // Trace capture state and instructions history
+    os.write(trg_fired, sizeof(trg_fired));
+    os.write(&capture, sizeof(capture));
+    os.write(&hist_size, sizeof(hist_size));
+    os.write(&hist_cnt, sizeof(hist_cnt));
+    os.write(&hist_idx, sizeof(hist_idx));
+    if (hist_size) os.write(hist_buf, hist_size * sizeof(trc_hist_t));
+    
+    // Trace files : base name, format, segments and manifest position
+    mpos = -1;
+    if (mfh)
+    {
+        fflush(mfh);
+        mpos = ftell(mfh);
+    }
+    os.write(bname, sizeof(bname));
+    os.write(&trc_fmt, sizeof(trc_fmt));
+    os.write(&gz_level, sizeof(gz_level));
+    os.write(&seg_limit, sizeof(seg_limit));
+    os.write(&seg_num, sizeof(seg_num));
+    os.write(&mpos, sizeof(mpos));
+    
+    if (async)
+    {
+        this->startWorker(ring);
+    }
+}
+
+// Restore the ISS state from a checkpoint and re-open the outputs
+int RISCVTrace::restore(VerilatedDeserialize &is)
+{
+    vluint32_t size;
+    int        depth;
+    long       mpos;
+    
+    // Close the current outputs
+    this->close();
+    
+    // C-Model state
+    is.read(gp_regs, sizeof(gp_regs));
+    is.read(&pc_reg, sizeof(pc_reg));
+    is.read(csr_regs, sizeof(csr_regs));
+    is.read(&isr_on, sizeof(isr_on));
+    is.read(&except_nr, sizeof(except_nr));
+    is.read(&inst_cnt, sizeof(inst_cnt));
+    is.read(&curr_stamp, sizeof(curr_stamp));
+    is.read(&prev_clk, sizeof(prev_clk));
+    is.read(&rd_idx, sizeof(rd_idx));
+    is.read(&mem_xfer, sizeof(mem_xfer));
+    is.read(&mem_mask, sizeof(mem_mask));
+    is.read(&mem_addr, sizeof(mem_addr));
+    is.read(&mem_data, sizeof(mem_data));
+    is.read(&jmp_addr, sizeof(jmp_addr));
+    is.read(&bin_pc, sizeof(bin_pc));
+    
+    // Compliance tests results
+    is.read(&size, sizeof(size));
+    if (size != test_size)
+    {
+        printf("Checkpoint signature is %u bytes instead of %u !\n", size, test_size);
+        return -1;
+    }
+    if (test_size) is.read(test_ptr, test_size);
+    
+    // Trace capture state and instructions history (dropped if the depth differs)
+    is.read(trg_fired, sizeof(trg_fired));
+    is.read(&capture, sizeof(capture));
+    is.read(&depth, sizeof(depth));
+    is.read(&hist_cnt, sizeof(hist_cnt));
+    is.read(&hist_idx, sizeof(hist_idx));
+    if (depth == hist_size)
+    {
+        if (hist_size) is.read(hist_buf, hist_size * sizeof(trc_hist_t));
+    }
+    else
+    {
+        trc_hist_t tmp;
+        
+        for (int i = 0; i < depth; i++) is.read(&tmp, sizeof(tmp));
+        hist_cnt = 0;
+        hist_idx = 0;
+    }
+    
+    // Trace files : base name, format, segments and manifest position
+    is.read(bname, sizeof(bname));
+    is.read(&trc_fmt, sizeof(trc_fmt));
+    is.read(&gz_level, sizeof(gz_level));
+    is.read(&seg_limit, sizeof(seg_limit));
+    is.read(&seg_num, sizeof(seg_num));
+    is.read(&mpos, sizeof(mpos));
+    if (!bname[0]) return 0;
+    
+    // Manifest truncated to the checkpoint
+    if (mpos >= 0)
+    {
+        char mname[256];
+        
+        sprintf(mname, "%s.manifest", bname);
+        mfh = fopen(mname, "r+");
+        if (mfh)
+        {
+            if (ftruncate(fileno(mfh), (off_t)mpos))
+            {
+                printf("Cannot truncate \"%s\" !\n", mname);
+            }
+            fseek(mfh, 0, SEEK_END);
+        }
+        else
+        {
+            mfh = fopen(mname, "w");
+        }
+    }
+    
+    // Trace segment started at the checkpoint
+    if (open_segment())
+    {
+        return -1;
+    }
+    
+    return openSignature(bname);
+}
+
+// Dump trace
+void RISCVTrace::dump
+(
+    vluint64_t stamp,
+    // Clock
+    vluint8_t  clk,
+    // Instruction fetch
+    vluint8_t  i_rd_ack,
+    vluint32_t i_address,
+    vluint32_t i_rddata,
+    // Data read/write
+    vluint8_t  d_rd_ack,
+    vluint8_t  d_wr_ack,
+    vluint32_t d_address,
+    vluint8_t  d_byteena,
+    vluint32_t d_rddata,
+    vluint32_t d_wrdata,
+    // Interrupt Receiver
+    vluint32_t inr_ir_irq,
+    // Register write-back
+    vluint8_t  wb_ena,
+    vluint8_t  wb_idx,
+    vluint32_t wb_data
+)
+{
+    // Rising edge on clock
+    if (clk && !prev_clk)
+    {
+        sample(stamp,
+               i_rd_ack,  i_address, i_rddata,
+               d_rd_ack,  d_wr_ack,  d_address,
+               d_byteena, d_rddata,  d_wrdata,
+               inr_ir_irq,
+               wb_ena,    wb_idx,    wb_data);
+    }
+    prev_clk = clk;
+}
+
+// Trace one clock cycle (called on the rising edges only)
+void RISCVTrace::sample
+(
+    vluint64_t stamp,
+    // Instruction fetch
+    vluint8_t  i_rd_ack,
+    vluint32_t i_address,
+    vluint32_t i_rddata,
+    // Data read/write
+    vluint8_t  d_rd_ack,
+    vluint8_t  d_wr_ack,
+    vluint32_t d_address,
+    vluint8_t  d_byteena,
+    vluint32_t d_rddata,
+    vluint32_t d_wrdata,
+    // Interrupt Receiver
+    vluint32_t inr_ir_irq,
+    // Register write-back
+    vluint8_t  wb_ena,
+    vluint8_t  wb_idx,
+    vluint32_t wb_data
+)
+{
+    // Some bus or writeback activity
+    if (i_rd_ack | d_rd_ack | d_wr_ack | wb_ena)
+    {
+        trc_sample_t *smp;
+        trc_sample_t  tmp;
+        vluint32_t    head;
+        
+        if (worker)
+        {
+            // Wait for a free slot in the ring
+            head = smp_head.load(std::memory_order_relaxed);
+            while (head - smp_tail.load(std::memory_order_acquire) >= smp_size)
+            {
+                std::this_thread::yield();
+            }
+            smp = &smp_ring[head & (smp_size - 1)];
+        }
+        else
+        {
+            smp = &tmp;
+        }
+        
+        smp->stamp     = stamp;
+        smp->i_rd_ack  = i_rd_ack;
+        smp->i_address = i_address;
+        smp->i_rddata  = i_rddata;
+        smp->d_rd_ack  = d_rd_ack;
+        smp->d_wr_ack  = d_wr_ack;
+        smp->d_address = d_address;
+        smp->d_byteena = d_byteena;
+        smp->d_rddata  = d_rddata;
+        smp->d_wrdata  = d_wrdata;
+        smp->wb_ena    = wb_ena;
+        smp->wb_idx    = wb_idx;
+        smp->wb_data   = wb_data;
+        
+        if (worker)
+        {
+            // Hand over the sample to the worker thread
+            smp_head.store(head + 1, std::memory_order_release);
+        }
+        else
+        {
+            process(smp);
+        }
+    }
+}
+
+// Run the lockstep checking and the trace output in a separate thread
+int RISCVTrace::startWorker(vluint32_t ring_size)
+{
+    if (worker) return 0;
+    
+    // Power of two ring size
+    smp_size = 1024;
+    while (smp_size < ring_size) smp_size <<= 1;
+    smp_ring = new trc_sample_t[smp_size];
+    smp_head.store(0);
+    smp_tail.store(0);
+    smp_stop.store(false);
+    
+    worker = new std::thread(&RISCVTrace::worker_loop, this);
+    
+    return 0;
+}
+
+// Drain the ring and stop the worker thread
+void RISCVTrace::stopWorker(void)
+{
+    if (!worker) return;
+    
+    smp_stop.store(true, std::memory_order_release);
+    worker->join();
+    delete worker;
+    worker = NULL;
+    
+    delete [] smp_ring;
+    smp_ring = NULL;
+}
+
+// Worker thread : consume the samples captured by dump()
+void RISCVTrace::worker_loop(void)
+{
+    vluint32_t tail = smp_tail.load(std::memory_order_relaxed);
+    
+    while (true)
+    {
+        vluint32_t head = smp_head.load(std::memory_order_acquire);
+        
+        if (head == tail)
+        {
+            // Ring is empty : exit only when the producer is done
+            if (smp_stop.load(std::memory_order_acquire))
+            {
+                if (head == smp_head.load(std::memory_order_acquire)) break;
+                continue;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        
+        while (tail != head)
+        {
+            process(&smp_ring[tail & (smp_size - 1)]);
+            tail++;
+            // Release the slots in batches
+            if ((tail & 63) == 0) smp_tail.store(tail, std::memory_order_release);
+        }
+        smp_tail.store(tail, std::memory_order_release);
+    }
+}
+
+// Process one bus/writeback sample : lockstep checking and trace output
+void RISCVTrace::process(const trc_sample_t *smp)
+{
+    vluint64_t stamp     = smp->stamp;
+    vluint8_t  i_rd_ack  = smp->i_rd_ack;
+    vluint32_t i_address = smp->i_address;
+    vluint32_t i_rddata  = smp->i_rddata;
+    vluint8_t  d_rd_ack  = smp->d_rd_ack;
+    vluint8_t  d_wr_ack  = smp->d_wr_ack;
+    vluint32_t d_address = smp->d_address;
+    vluint8_t  d_byteena = smp->d_byteena;
+    vluint32_t d_rddata  = smp->d_rddata;
+    vluint32_t d_wrdata  = smp->d_wrdata;
+    vluint8_t  wb_ena    = smp->wb_ena;
+    vluint8_t  wb_idx    = smp->wb_idx;
+    vluint32_t wb_data   = smp->wb_data;
+    bool       isr_prev;
+    
+    curr_stamp = stamp;
+    
+    // Trace capture windows
+    if (capture)
+    {
+        if (trigger(TRG_STOP, smp)) capture = false;
+    }
+    else
+    {
+        if (trigger(TRG_START, smp))
+        {
+            capture = true;
+            hist_flush();
+        }
+    }
+    
+    //ip_reg = ip_reg | inr_ir_irq & im_reg;
+    if (wb_ena)
+    {
+        if (wb_idx != rd_idx)
+        {
+            mismatch(MIS_WB_INDEX, wb_idx, rd_idx);
+        }
+        else if ((gp_regs[rd_idx] != wb_data) && (rd_idx))
+        {
+            mismatch(MIS_WB_DATA, wb_data, gp_regs[rd_idx]);
+        }
+    }
+    if (d_rd_ack)
+    {
+        if (!capture)
+        {
+            // Outside of a capture window
+        }
+        else if (trc_fmt == TRC_FMT_BIN)
+        {
+            bin_record(BIN_TAG_MEM_RD, stamp);
+            bin_put32(d_address);
+            bin_put32(d_rddata);
+            bin_flush();
+        }
+        else
+        {
+            char buf[64];
+            
+            trc_write(buf, txt_mem_rd(buf, d_address, d_rddata));
+        }
+        
+        // Instruction simulation (memory/writeback)
+        riscv_simu_rd(d_address, d_rddata);
+    }
+    if (d_wr_ack)
+    {
+        if (!capture)
+        {
+            // Outside of a capture window
+        }
+        else if (trc_fmt == TRC_FMT_BIN)
+        {
+            bin_record(BIN_TAG_MEM_WR, stamp);
+            bin_put32(d_address);
+            bin_buf[bin_len++] = d_byteena;
+            bin_put32(d_wrdata);
+            bin_flush();
+        }
+        else
+        {
+            char buf[64];
+            
+            trc_write(buf, txt_mem_wr(buf, d_address, d_wrdata, d_byteena));
+        }
+        
+        // Compliance test signature
+        sig_write(d_address, d_wrdata, d_byteena);
+        
+        // Instruction simulation (memory)
+        riscv_simu_wr(d_address, d_wrdata, d_byteena);
+    }
+    if (i_rd_ack)
+    {
+        if (capture)
+        {
+            // CPU registers and instruction being fetched
+            emit_fetch(stamp, i_address, i_rddata, pc_reg, gp_regs);
+        }
+        else if (hist_size)
+        {
+            // Keep the instruction in the history ring
+            hist_push(hist_buf, hist_size, &hist_idx, &hist_cnt, stamp, i_address, i_rddata);
+        }
+        if (fail_size)
+        {
+            // Last instructions for the mismatch report
+            hist_push(fail_buf, fail_size, &fail_idx, &fail_cnt, stamp, i_address, i_rddata);
+        }
+        inst_cnt++;
+        if (prof)
+        {
+            // Cycles of the previous instruction, fetch counted on this address
+            prof->fetch(stamp, i_address);
+            // Interrupt taken by the Verilog model (not simulated by the C-Model)
+            if ((i_address != pc_reg) && (i_address == csr_regs[CSR_MTVEC]) && (!isr_on))
+            {
+                prof->interrupt(pc_reg);
+            }
+        }
+        
+        // Instruction simulation (fetch/decode/execute/writeback)
+        isr_prev = isr_on;
+        riscv_simu_if(i_address, i_rddata);
+        if (prof) prof_flow(i_address, i_rddata, isr_prev);
+        
+        // Jump to itself : only an interrupt can leave the loop
+        if ((pc_reg == i_address) && (!(csr_regs[CSR_MIE] & 0x80)))
+        {
+            halt_hit.store(true, std::memory_order_release);
+        }
+    }
+}
+
+/******************************************************************************/
+/** Trace capture triggers                                                   **/
+/******************************************************************************/
+
+// Check a trigger against a bus/writeback sample
+bool RISCVTrace::trigger(int idx, const trc_sample_t *smp)
+{
+    vluint64_t value = trg_value[idx];
+    
+    switch (trg_type[idx])
+    {
+        case TRG_PC:
+        {
+            return (smp->i_rd_ack) && (smp->i_address == (vluint32_t)value);
+        }
+        case TRG_INSTR:
+        {
+            // One-shot
+            if ((trg_fired[idx]) || (!smp->i_rd_ack) || (inst_cnt < value)) return false;
+            trg_fired[idx] = true;
+            return true;
+        }
+        case TRG_TIME:
+        {
+            // One-shot
+            if ((trg_fired[idx]) || (smp->stamp < value)) return false;
+            trg_fired[idx] = true;
+            return true;
+        }
+        case TRG_WRITE:
+        {
+            return (smp->d_wr_ack) && ((smp->d_address & 0xFFFFFFFC) == ((vluint32_t)value & 0xFFFFFFFC));
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+// Output an instruction fetch with the registers state
+void RISCVTrace::emit_fetch(vluint64_t stamp, vluint32_t addr, vluint32_t inst, vluint32_t pc, const vluint32_t *regs)
+{
+    // Segment full : continue in the next one
+    if ((seg_limit) && (seg_bytes >= seg_limit))
+    {
+        openNext();
+    }
+    
+    // Segment range, for the manifest
+    if (!seg_fetch) seg_beg_ps = stamp;
+    seg_end_ps = stamp;
+    if (addr < seg_min_pc) seg_min_pc = addr;
+    if (addr > seg_max_pc) seg_max_pc = addr;
+    seg_fetch++;
+    
+    if (trc_fmt == TRC_FMT_BIN)
+    {
+        // Registers changes, then instruction being fetched
+        bin_regs(regs);
+        if (addr != pc)
+        {
+            // C-Model PC needed for the disassembly
+            bin_record(BIN_TAG_FETCH_D, stamp);
+            bin_put32(addr);
+            bin_put32(inst);
+            bin_put32(pc);
+        }
+        else if (addr == bin_pc + 4)
+        {
+            bin_record(BIN_TAG_FETCH_S, stamp);
+            bin_put32(inst);
+        }
+        else
+        {
+            bin_record(BIN_TAG_FETCH, stamp);
+            bin_put32(addr);
+            bin_put32(inst);
+        }
+        bin_flush();
+        bin_pc = addr;
+    }
+    else
+    {
+        char buf[512];
+        int  len;
+        
+        len  = txt_regs(buf, regs);
+        len += txt_fetch(buf + len, stamp, addr, inst, pc);
+        trc_write(buf, len);
+    }
+}
+
+// Output the instructions kept before the start trigger
+void RISCVTrace::hist_flush(void)
+{
+    int idx = hist_idx - hist_cnt;
+    
+    if (idx < 0) idx += hist_size;
+    while (hist_cnt)
+    {
+        trc_hist_t *p = &hist_buf[idx];
+        
+        emit_fetch(p->stamp, p->addr, p->inst, p->pc, p->regs);
+        idx = (idx + 1 == hist_size) ? 0 : idx + 1;
+        hist_cnt--;
+    }
+}
+
+// Keep an instruction with the C-Model state in a history ring
+void RISCVTrace::hist_push(trc_hist_t *ring, int size, int *idx, int *cnt,
+                           vluint64_t stamp, vluint32_t addr, vluint32_t inst)
+{
+    trc_hist_t *p = &ring[*idx];
+    
+    p->stamp = stamp;
+    p->addr  = addr;
+    p->inst  = inst;
+    p->pc    = pc_reg;
+    memcpy(p->regs, gp_regs, sizeof(p->regs));
+    *idx = (*idx + 1 == size) ? 0 : *idx + 1;
+    if (*cnt < size) (*cnt)++;
+}
+
+// Keep the bytes written into the compliance test signature range
+void RISCVTrace::sig_write(vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    if ((test_ptr) && (addr >= test_start) && (addr < test_stop))
+    {
+        vluint32_t offs = (addr & 0xFFFFFFFC) - test_start;
+        if (mask & 1) test_ptr[offs+0] = (vluint8_t)(data >> 0);
+        if (mask & 2) test_ptr[offs+1] = (vluint8_t)(data >> 8);
+        if (mask & 4) test_ptr[offs+2] = (vluint8_t)(data >> 16);
+        if (mask & 8) test_ptr[offs+3] = (vluint8_t)(data >> 24);
+    }
+}
+
+/******************************************************************************/
+/** Text trace output                                                        **/
+/******************************************************************************/
+
+// CPU registers
+int RISCVTrace::txt_regs(char *buf, const vluint32_t *regs)
+{
+    int len;
+    
+    len  = sprintf(buf, " x0 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[ 0], regs[ 1], regs[ 2], regs[ 3],
+            regs[ 4], regs[ 5], regs[ 6], regs[ 7]
+           );
+    len += sprintf(buf + len, " x8 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[ 8], regs[ 9], regs[10], regs[11],
+            regs[12], regs[13], regs[14], regs[15]
+           );
+    len += sprintf(buf + len, "x16 : %08X %08X %08X %08X %08X %08X %08X %08X\n",
+            regs[16], regs[17], regs[18], regs[19],
+            regs[20], regs[21], regs[22], regs[23]
+           );
+    len += sprintf(buf + len, "x24 : %08X %08X %08X %08X %08X %08X %08X %08X\n\n",
+            regs[24], regs[25], regs[26], regs[27],
+            regs[28], regs[29], regs[30], regs[31]
+           );
+    
+    return len;
+}
+
+// Instruction fetch with disassembly (and function of the fetch address)
+int RISCVTrace::txt_fetch(char *buf, vluint64_t stamp, vluint32_t addr, vluint32_t inst, vluint32_t pc)
+{
+    char dasm[80];
+    char func[TRC_SYM_LEN + 16];
+    
+    riscv_dasm(dasm, inst, pc);
+    if ((sym_tab) && (sym_str(func, pc, TRC_SYM_LEN)))
+    {
+        return sprintf(buf, "(%14llu ps) %08X : %08X %-40s%s\n", stamp, addr, inst, dasm, func);
+    }
+    return sprintf(buf, "(%14llu ps) %08X : %08X %s\n", stamp, addr, inst, dasm);
+}
+
+// Memory read
+int RISCVTrace::txt_mem_rd(char *buf, vluint32_t addr, vluint32_t data)
+{
+    return sprintf(buf, "Memory read @ $%08X : %08X\n", addr, data);
+}
+
+// Memory write (masked bytes shown as $XX)
+int RISCVTrace::txt_mem_wr(char *buf, vluint32_t addr, vluint32_t data, vluint8_t mask)
+{
+    char hex[12];
+    char val[10];
+    
+    memcpy(val + 6, (mask & 1) ? uhex_to_str(hex, data >>  0, 2) : "$XX", 3);
+    memcpy(val + 4, (mask & 2) ? uhex_to_str(hex, data >>  8, 2) : "$XX", 3);
+    memcpy(val + 2, (mask & 4) ? uhex_to_str(hex, data >> 16, 2) : "$XX", 3);
+    memcpy(val + 0, (mask & 8) ? uhex_to_str(hex, data >> 24, 2) : "$XX", 3);
+    val[9] = (char)0;
+    
+    return sprintf(buf, "Memory write @ $%08X : %s\n", addr, val);
+}
+
+// Verilog vs C-Model mismatch
+int RISCVTrace::txt_mismatch(char *buf, vluint64_t stamp, int kind, vluint32_t rtl, vluint32_t model)
+{
+    int len;
+    
+    len = sprintf(buf, "!!! %s MISMATCH !!! (%14llu ps)\n", mismatch_str[kind], stamp);
+    switch (kind)
+    {
+        case MIS_WB_INDEX:
+        {
+            len += sprintf(buf + len, "Verilog : %2d, C-Model : %2d\n", rtl, model);
+            break;
+        }
+        case MIS_DATA_XFER:
+        {
+            break;
+        }
+        case MIS_DATA_MASK:
+        {
+            len += sprintf(buf + len, "Verilog : %1X, C-Model : %1X\n", rtl, model);
+            break;
+        }
+        default:
+        {
+            len += sprintf(buf + len, "Verilog : %08X, C-Model : %08X\n", rtl, model);
+        }
+    }
+    
+    return len;
+}
+
+/******************************************************************************/
+/** Binary trace output                                                      **/
+/******************************************************************************/
+
+// File header
+void RISCVTrace::bin_header(void)
+{
+    trc_write(BIN_MAGIC, 8);
+    bin_len = 0;
+    bin_put32(bin_pc + 4);
+    bin_flush();
+}
+
+// Start a record : tag + time stamp delta
+void RISCVTrace::bin_record(vluint8_t tag, vluint64_t stamp)
+{
+    vluint64_t delta = stamp - bin_stamp;
+    
+    bin_stamp = stamp;
+    bin_len = 0;
+    bin_buf[bin_len++] = tag;
+    while (delta >= 0x80)
+    {
+        bin_buf[bin_len++] = (vluint8_t)(delta | 0x80);
+        delta >>= 7;
+    }
+    bin_buf[bin_len++] = (vluint8_t)delta;
+}
+
+// Append a 32-bit value to the current record
+void RISCVTrace::bin_put32(vluint32_t val)
+{
+    bin_buf[bin_len++] = (vluint8_t)(val >>  0);
+    bin_buf[bin_len++] = (vluint8_t)(val >>  8);
+    bin_buf[bin_len++] = (vluint8_t)(val >> 16);
+    bin_buf[bin_len++] = (vluint8_t)(val >> 24);
+}
+
+// Write the current record
+void RISCVTrace::bin_flush(void)
+{
+    trc_write((const char *)bin_buf, bin_len);
+    bin_len = 0;
+}
+
+// Registers changed since the last fetch
+void RISCVTrace::bin_regs(const vluint32_t *regs)
+{
+    for (int i = 1; i < 32; i++)
+    {
+        if (regs[i] != bin_gp_regs[i])
+        {
+            bin_gp_regs[i] = regs[i];
+            bin_len = 0;
+            bin_buf[bin_len++] = BIN_TAG_REG;
+            bin_buf[bin_len++] = (vluint8_t)i;
+            bin_put32(regs[i]);
+            bin_flush();
+        }
+    }
+}
+
+// Report a Verilog vs C-Model mismatch
+void RISCVTrace::mismatch(int kind, vluint32_t rtl, vluint32_t model)
+{
+    if (trc_fmt == TRC_FMT_BIN)
+    {
+        bin_record(BIN_TAG_MISMATCH, curr_stamp);
+        bin_buf[bin_len++] = (vluint8_t)kind;
+        bin_put32(rtl);
+        bin_put32(model);
+        bin_flush();
+    }
+    else
+    {
+        char buf[128];
+        
+        trc_write(buf, txt_mismatch(buf, curr_stamp, kind, rtl, model));
+    }
+    
+    // Fail-fast : only the first mismatch is reported
+    if ((fail_size) && (!fail_hit.load(std::memory_order_relaxed)))
+    {
+        fail_report(kind, rtl, model);
+        fail_hit.store(true, std::memory_order_release);
+    }
+}
+
+/******************************************************************************/
+/** fail_report()                                                            **/
+/** ------------------------------------------------------------------------ **/
+/** Write the first mismatch into a JSON report : kind, time, instruction    **/
+/** (last fetch), Verilog vs C-Model values, registers and last instructions **/
+/**   kind  : mismatch kind (MIS_xxx)                                        **/
+/**   rtl   : Verilog value                                                  **/
+/**   model : C-Model value (expected)                                       **/
+/******************************************************************************/
+
+void RISCVTrace::fail_report(int kind, vluint32_t rtl, vluint32_t model)
+{
+    FILE       *fh;
+    trc_hist_t *p;
+    char        dasm[80];
+    int         idx;
+    
+    fh = fopen(fname, "w");
+    if (!fh)
+    {
+        printf("Cannot create mismatch report \"%s\" !\n", fname);
+        return;
+    }
+    
+    // Instruction being checked : last one fetched
+    idx = (fail_idx) ? fail_idx - 1 : fail_size - 1;
+    p   = (fail_cnt) ? &fail_buf[idx] : NULL;
+    
+    fprintf(fh, "{\n");
+    fprintf(fh, "  \"kind\": \"%s\",\n", mismatch_str[kind]);
+    fprintf(fh, "  \"time_ps\": %llu,\n", curr_stamp);
+    fprintf(fh, "  \"inst_count\": %llu,\n", inst_cnt);
+    fprintf(fh, "  \"address\": \"%08X\",\n", (p) ? p->addr : pc_reg);
+    fprintf(fh, "  \"pc\": \"%08X\",\n", (p) ? p->pc : pc_reg);
+    fprintf(fh, "  \"inst\": \"%08X\",\n", (p) ? p->inst : 0);
+    if (p)
+    {
+        riscv_dasm(dasm, p->inst, p->pc);
+        fprintf(fh, "  \"dasm\": \"%s\",\n", dasm);
+    }
+    fprintf(fh, "  \"verilog\": \"%08X\",\n", rtl);
+    fprintf(fh, "  \"expected\": \"%08X\",\n", model);
+    
+    // C-Model registers
+    fprintf(fh, "  \"regs\": [");
+    for (int i = 0; i < 32; i++)
+    {
+        fprintf(fh, "%s\"%08X\"", (i) ? ", " : "", gp_regs[i]);
+    }
+    fprintf(fh, "],\n");
+    
+    // Last instructions, oldest first
+    fprintf(fh, "  \"history\": [\n");
+    idx = fail_idx - fail_cnt;
+    if (idx < 0) idx += fail_size;
+    for (int i = 0; i < fail_cnt; i++)
+    {
+        p = &fail_buf[idx];
+        riscv_dasm(dasm, p->inst, p->pc);
+        fprintf(fh, "    { \"time_ps\": %llu, \"address\": \"%08X\", \"pc\": \"%08X\", \"inst\": \"%08X\", \"dasm\": \"%s\" }%s\n",
+                p->stamp, p->addr, p->pc, p->inst, dasm, (i + 1 < fail_cnt) ? "," : "");
+        idx = (idx + 1 == fail_size) ? 0 : idx + 1;
+    }
+    fprintf(fh, "  ]\n");
+    fprintf(fh, "}\n");
+    fclose(fh);
+}
+
+// Convert a binary trace (plain or gzip compressed) back into the text trace layout
+int RISCVTrace::decode(const char *bin_name, const char *txt_name)
+{
+    gzFile bfh;
+    FILE *xfh;
+    char magic[8];
+    char buf[512];
+    vluint32_t regs[32];
+    vluint64_t stamp;
+    vluint32_t pc;
+    long offs;
+    bool trunc;
+    int tag;
+    
+    bfh = gzopen(bin_name, "rb");
+    if (!bfh)
+    {
+        printf("Cannot open binary trace \"%s\"!\n", bin_name);
+        return -1;
+    }
+    if ((gzread(bfh, magic, 8) != 8) || (memcmp(magic, BIN_MAGIC, 8)))
+    {
+        printf("\"%s\" is not a binary trace!\n", bin_name);
+        gzclose(bfh);
+        return -1;
+    }
+    xfh = (txt_name) ? fopen(txt_name, "w") : stdout;
+    if (!xfh)
+    {
+        printf("Cannot create text trace \"%s\"!\n", txt_name);
+        gzclose(bfh);
+        return -1;
+    }
+    gzbuffer(bfh, 1 << 20);
+    setvbuf(xfh, NULL, _IOFBF, 1 << 20);
+    
+    for (int i = 0; i < 32; i++)
+    {
+        regs[i] = (vluint32_t)0;
+    }
+    stamp = (vluint64_t)0;
+    trunc = false;
+    pc    = fget32(bfh, &trunc) - 4;
+    if (trunc)
+    {
+        printf("Truncated header in \"%s\"!\n", bin_name);
+        gzclose(bfh);
+        if (xfh != stdout) fclose(xfh);
+        return -1;
+    }
+    
+    offs = (long)gztell(bfh);
+    while ((tag = gzgetc(bfh)) >= 0)
+    {
+        if (tag != BIN_TAG_REG)
+        {
+            stamp += fgetleb(bfh, &trunc);
+        }
+        switch (tag)
+        {
+            case BIN_TAG_FETCH:
+            case BIN_TAG_FETCH_S:
+            case BIN_TAG_FETCH_D:
+            {
+                vluint32_t inst;
+                vluint32_t model_pc;
+                
+                pc       = (tag == BIN_TAG_FETCH_S) ? pc + 4 : fget32(bfh, &trunc);
+                inst     = fget32(bfh, &trunc);
+                model_pc = (tag == BIN_TAG_FETCH_D) ? fget32(bfh, &trunc) : pc;
+                int len;
+                
+                if (trunc) break;
+                len  = txt_regs(buf, regs);
+                len += txt_fetch(buf + len, stamp, pc, inst, model_pc);
+                fwrite(buf, 1, len, xfh);
+                break;
+            }
+            case BIN_TAG_REG:
+            {
+                int        idx = fget8(bfh, &trunc) & 31;
+                vluint32_t val = fget32(bfh, &trunc);
+                
+                if (trunc) break;
+                regs[idx] = val;
+                break;
+            }
+            case BIN_TAG_MEM_RD:
+            {
+                vluint32_t addr = fget32(bfh, &trunc);
+                vluint32_t data = fget32(bfh, &trunc);
+                
+                if (trunc) break;
+                fwrite(buf, 1, txt_mem_rd(buf, addr, data), xfh);
+                break;
+            }
+            case BIN_TAG_MEM_WR:
+            {
+                vluint32_t addr = fget32(bfh, &trunc);
+                vluint8_t  mask = (vluint8_t)fget8(bfh, &trunc);
+                vluint32_t data = fget32(bfh, &trunc);
+                
+                if (trunc) break;
+                fwrite(buf, 1, txt_mem_wr(buf, addr, data, mask), xfh);
+                break;
+            }
+            case BIN_TAG_MISMATCH:
+            {
+                int        kind  = fget8(bfh, &trunc);
+                vluint32_t rtl   = fget32(bfh, &trunc);
+                vluint32_t model = fget32(bfh, &trunc);
+                
+                if (trunc) break;
+                if (kind > MIS_DATA_MASK)
+                {
+                    printf("Unknown mismatch kind %d at offset %ld!\n", kind, offs);
+                    gzclose(bfh);
+                    if (xfh != stdout) fclose(xfh);
+                    return -1;
+                }
+                fwrite(buf, 1, txt_mismatch(buf, stamp, kind, rtl, model), xfh);
+                break;
+            }
+            default:
+            {
+                printf("Unknown record type %02X at offset %ld!\n", tag, offs);
+                gzclose(bfh);
+                if (xfh != stdout) fclose(xfh);
+                return -1;
+            }
+        }
+        if (trunc)
+        {
+            printf("Truncated record at offset %ld!\n", offs);
+            gzclose(bfh);
+            if (xfh != stdout) fclose(xfh);
+            return -1;
+        }
+        offs = (long)gztell(bfh);
+    }
+    
+    gzclose(bfh);
+    if (xfh != stdout) fclose(xfh);
+    
+    return 0;
+}
+
+// Execute one instruction without Verilog model (returns 1 on a dead loop)
+int RISCVTrace::step(RISCVBus *bus, bool tmr_int)
+{
+    vluint32_t pc = pc_reg;
+    
+    // Timer interrupt
+    if (riscv_irq(tmr_int))
+    {
+        return 0;
+    }
+    
+    // Fetch, decode, execute
+    inst_cnt++;
+    riscv_simu_if(pc_reg, bus->read(pc_reg));
+    
+    // Memory access
+    if (mem_xfer == XFER_NONE)
+    {
+        // No load / store
+    }
+    else if (mem_xfer & 8)
+    {
+        bus->write(mem_addr, mem_data, mem_mask);
+        sig_write(mem_addr, mem_data, mem_mask);
+        riscv_simu_wr(mem_addr, mem_data, mem_mask);
+    }
+    else
+    {
+        riscv_simu_rd(mem_addr, bus->read(mem_addr));
+    }
+    
+    // Jump to itself : only an interrupt can leave the loop
+    return ((pc_reg == pc) && (!(csr_regs[CSR_MIE] & 0x80))) ? 1 : 0;
+}
+
+// Architectural state : general purpose register
+vluint32_t RISCVTrace::getReg(int idx)
+{
+    return gp_regs[idx & 31];
+}
+
+// Architectural state : program counter
+vluint32_t RISCVTrace::getPc(void)
+{
+    return pc_reg;
+}
+
+// Architectural state : CSR value
+vluint32_t RISCVTrace::getCsr(int csr)
+{
+    return csr_regs[csr & 0xFFF];
+}
+
+// Architectural state : exception / interrupt handler running
+bool RISCVTrace::inIsr(void)
+{
+    return isr_on;
+}
+
+// Instructions executed so far
+vluint64_t RISCVTrace::getInstCount(void)
+{
+    return inst_cnt;
+}
+
+// Instructions of the loop iterations jumped over by the testbench (idle skip) :
+// counted for the triggers, the worker thread processes the samples before first
+void RISCVTrace::skipInstr(vluint64_t num)
+{
+    if (worker)
+    {
+        while (smp_tail.load(std::memory_order_acquire) != smp_head.load(std::memory_order_relaxed))
+        {
+            std::this_thread::yield();
+        }
+    }
+    inst_cnt += num;
+    if (prof) prof->skip(num);
+}
+
+// Guest profiler : fetches counted per address (NULL : disabled, the profiler must outlive the trace)
+void RISCVTrace::setProfiler(Profiler *profiler)
+{
+    prof = profiler;
+}
+
+// Call graph event of the instruction just executed by the C-Model (calls and
+// returns through ra, exception handler entry / exit)
+void RISCVTrace::prof_flow(vluint32_t addr, vluint32_t inst, bool isr_prev)
+{
+    vluint32_t rd  = (inst >> 7) & 31;
+    vluint32_t rs1 = (inst >> 15) & 31;
+    
+    if ((isr_on) && (!isr_prev))
+    {
+        prof->flow(PROF_FLOW_TRAP, addr);
+    }
+    else if (inst == 0x30200073) // MRET
+    {
+        prof->flow(PROF_FLOW_MRET, addr);
+    }
+    else if ((inst & 0x7F) == OPC_JAL)
+    {
+        if (rd == 1) prof->flow(PROF_FLOW_CALL, addr);
+    }
+    else if ((inst & 0x707F) == OPC_JALR)
+    {
+        if (rd == 1)                      prof->flow(PROF_FLOW_CALL, addr);
+        else if ((rd == 0) && (rs1 == 1)) prof->flow(PROF_FLOW_RET, addr);
+    }
+}
+
+// Disassemble one instruction into 32 characters (8 x 32-bit, 1st char in LSB)
+void RISCVTrace::disasm(vluint32_t inst, vluint32_t pc, vluint32_t *text)
+{
+    trc_dasm_t *p;
+    
+    // Direct mapped cache, keyed by (instruction, PC)
+    p = &dasm_cache[((pc >> 2) ^ (inst >> 7)) & (DASM_CACHE_SIZE - 1)];
+    if ((p->pc != pc) || (p->inst != inst))
+    {
+        char buf[80];
+        
+        memset(buf, 0, sizeof(buf));
+        riscv_dasm(buf, inst, pc);
+        for (int i = 0; i < 8; i++)
+        {
+            p->text[i] = ((vluint32_t)(vluint8_t)buf[(i << 2) + 0] <<  0)
+                       | ((vluint32_t)(vluint8_t)buf[(i << 2) + 1] <<  8)
+                       | ((vluint32_t)(vluint8_t)buf[(i << 2) + 2] << 16)
+                       | ((vluint32_t)(vluint8_t)buf[(i << 2) + 3] << 24);
+        }
+        p->inst = inst;
+        p->pc   = pc;
+    }
+    for (int i = 0; i < 8; i++)
+    {
+        text[i] = p->text[i];
+    }
+}
+
+/******************************************************************************/
+/** uhex_to_str()                                                            **/
+/** ------------------------------------------------------------------------ **/
+/** Convert an unsigned 32-bit value into a hexadecimal string               **/
+/**   buf : output string (12 characters)                                    **/
+/**   val : 32-bit value                                                     **/
+/**   dig : number of hexadecimal digits (1 - 8)                             **/
 /******************************************************************************/
 
-char *RISCVTrace::uhex_to_str(vluint32_t val, int dig)
+char *RISCVTrace::uhex_to_str(char *buf, vluint32_t val, int dig)
 {
-    static char buf[12];
     char *p;
     
     dig <<= 2;
@@ -563,13 +1913,13 @@ char *RISCVTrace::uhex_to_str(vluint32_t val, int dig)
 /** shex_to_str()                                                            **/
 /** ------------------------------------------------------------------------ **/
 /** Convert a signed 8/16/32-bit value into a hexadecimal string             **/
+/**   buf : output string (12 characters)                                    **/
 /**   val : 8/16/32-bit value                                                **/
 /**   dig : number of hexadecimal digits (1 - 8)                             **/
 /******************************************************************************/
 
-char *RISCVTrace::shex_to_str(vluint32_t val, int dig)
+char *RISCVTrace::shex_to_str(char *buf, vluint32_t val, int dig)
 {
-    static char buf[12];
     char *p;
     vluint32_t msk;
     
@@ -597,10 +1947,8 @@ char *RISCVTrace::shex_to_str(vluint32_t val, int dig)
     return buf;
 }
 
-char *RISCVTrace::get_csr_str(int csr)
+char *RISCVTrace::get_csr_str(char *buf, int csr)
 {
-    static char buf[8];
-    
     buf[0] = 0;
     switch (csr >> 3)
     {
@@ -639,8 +1987,29 @@ char *RISCVTrace::get_csr_str(int csr)
     return buf;
 }
 
+// " <name+0xoffset>" of an address (empty string without symbol)
+int RISCVTrace::sym_str(char *buf, vluint32_t addr, int max_len)
+{
+    const char *name;
+    vluint32_t offs;
+    
+    buf[0] = (char)0;
+    if ((!sym_tab) || (sym_tab->lookup(addr, &name, &offs))) return 0;
+    
+    if (offs)
+    {
+        return sprintf(buf, " <%.*s+0x%X>", max_len, name, offs);
+    }
+    return sprintf(buf, " <%.*s>", max_len, name);
+}
+
 void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
 {
+    // Hexadecimal value, CSR name and target symbol strings
+    char hex[12];
+    char name[8];
+    char func[DASM_SYM_LEN + 16];
+    
     vluint8_t func7;
     vluint8_t rd__idx;
     vluint8_t func3;
@@ -672,6 +2041,9 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
             | ((inst >> 20) & 0x000007FE)
             | ((inst >>  9) & 0x00000800)
             |  (inst        & 0x000FF000);
+    // Backward branches and jumps
+    if (b_immed & 0x00001000) b_immed |= 0xFFFFE000;
+    if (j_immed & 0x00100000) j_immed |= 0xFFE00000;
     z_immed =  (inst >> 15) & 0x0000001F;
     
     switch (func7)
@@ -682,7 +2054,7 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
             sprintf(buf, "%s %s,%s(%s)",
                     load_str[func3],
                     reg_str[rd__idx],
-                    shex_to_str(i_immed, 3),
+                    shex_to_str(hex, i_immed, 3),
                     reg_str[rs1_idx]
                    );
             break;
@@ -714,7 +2086,7 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
                 }
                 default:
                 {
-                    sprintf(buf, "f???   %s", uhex_to_str(inst, 8));
+                    sprintf(buf, "f???   %s", uhex_to_str(hex, inst, 8));
                 }
             }
             break;
@@ -729,7 +2101,7 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
                     op_imm_str[func3],
                     reg_str[rd__idx],
                     reg_str[rs1_idx],
-                    shex_to_str(i_immed, 3)
+                    shex_to_str(hex, i_immed, 3)
                    );
             break;
         }
@@ -739,7 +2111,7 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
         {
             sprintf(buf, "auipc   %s,%s",
                     reg_str[rd__idx],
-                    uhex_to_str(u_immed, 8)
+                    uhex_to_str(hex, u_immed, 8)
                    );
             break;
         }
@@ -750,7 +2122,7 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
             sprintf(buf, "%s %s,%s(%s)",
                     store_str[func3],
                     reg_str[rs2_idx],
-                    shex_to_str(s_immed, 3),
+                    shex_to_str(hex, s_immed, 3),
                     reg_str[rs1_idx]
                    );
             break;
@@ -775,7 +2147,7 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
         {
             sprintf(buf, "lui     %s,%s",
                     reg_str[rd__idx],
-                    uhex_to_str(u_immed, 8)
+                    uhex_to_str(hex, u_immed, 8)
                    );
             break;
         }
@@ -783,11 +2155,13 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
         // 0x63
         case OPC_BRANCH:
         {
-            sprintf(buf, "%s %s,%s,%s",
+            sym_str(func, pc + b_immed, DASM_SYM_LEN);
+            sprintf(buf, "%s %s,%s,%s%s",
                     branch_str[func3],
                     reg_str[rs1_idx],
                     reg_str[rs2_idx],
-                    uhex_to_str(pc + b_immed, 8)
+                    uhex_to_str(hex, pc + b_immed, 8),
+                    func
                    );
             break;
         }
@@ -797,7 +2171,7 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
         {
             sprintf(buf, "jalr    %s,%s(%s)",
                     reg_str[rd__idx],
-                    shex_to_str(i_immed, 3),
+                    shex_to_str(hex, i_immed, 3),
                     reg_str[rs1_idx]
                    );
             break;
@@ -806,9 +2180,11 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
         // 0x6F
         case OPC_JAL:
         {
-            sprintf(buf, "jal     %s,%s",
+            sym_str(func, pc + j_immed, DASM_SYM_LEN);
+            sprintf(buf, "jal     %s,%s%s",
                     reg_str[rd__idx],
-                    uhex_to_str(pc + j_immed, 8)
+                    uhex_to_str(hex, pc + j_immed, 8),
+                    func
                    );
             break;
         }
@@ -823,8 +2199,8 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
                 sprintf(buf, "%s %s,%s,%s",
                         system_str[func3],
                         reg_str[rd__idx],
-                        get_csr_str(csr),
-                        (func3 & 4) ? uhex_to_str(z_immed, 2) : reg_str[rs1_idx]
+                        get_csr_str(name, csr),
+                        (func3 & 4) ? uhex_to_str(hex, z_immed, 2) : reg_str[rs1_idx]
                        );
             }
             else
@@ -863,7 +2239,7 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
                     }
                     default:
                     {
-                        sprintf(buf, "csr??? %s", uhex_to_str(inst, 8));
+                        sprintf(buf, "csr??? %s", uhex_to_str(hex, inst, 8));
                     }
                 }
             }
@@ -872,381 +2248,349 @@ void RISCVTrace::riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc)
         
         default:
         {
-            sprintf(buf, "op???   %s",  uhex_to_str(inst, 8));
+            sprintf(buf, "op???   %s",  uhex_to_str(hex, inst, 8));
         }
     }
 }
 
-void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
+/******************************************************************************/
+/** riscv_decode()                                                           **/
+/** ------------------------------------------------------------------------ **/
+/** Decode one instruction : operation, registers indexes, immediate value   **/
+/**   d    : decoded instruction                                             **/
+/**   inst : 32-bit instruction                                              **/
+/******************************************************************************/
+
+void RISCVTrace::riscv_decode(trc_dinst_t *d, vluint32_t inst)
 {
-    vluint8_t func7;
     vluint8_t func3;
-    vluint8_t rs1_idx;
-    vluint8_t rs2_idx;
-    
     vluint32_t i_immed;
-    vluint32_t s_immed;
-    vluint32_t u_immed;
-    vluint32_t b_immed;
-    vluint32_t j_immed;
-    vluint32_t z_immed;
     
-    vluint32_t jmp_addr;
-    
-    unsigned long uns_imm;
-    signed   long sig_imm;
-    unsigned long uns_rs1;
-    signed   long sig_rs1;
-    unsigned long uns_rs2;
-    signed   long sig_rs2;
-    
-    if (addr != pc_reg)
-    {
-        fprintf(tfh, "!!! INST ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, pc_reg);
-    }
-    
-    func7   =  inst        & 0x7F;
-    rd_idx  = (inst >>  7) & 0x1F;
     func3   = (inst >> 12) & 0x07;
-    rs1_idx = (inst >> 15) & 0x1F;
-    rs2_idx = (inst >> 20) & 0x1F;
-    
-    i_immed =  (inst >> 20) & 0x00000FFF;
-    s_immed = ((inst >> 20) & 0x00000FE0)
-            | ((inst >>  7) & 0x0000001F);
-    u_immed =   inst        & 0xFFFFF000;
-    b_immed = ((inst >> 19) & 0x00001000)
-            | ((inst >> 20) & 0x000007E0)
-            | ((inst >>  7) & 0x0000001E)
-            | ((inst <<  4) & 0x00000800);
-    j_immed = ((inst >> 11) & 0x00100000)
-            | ((inst >> 20) & 0x000007FE)
-            | ((inst >>  9) & 0x00000800)
-            |  (inst        & 0x000FF000);
-    z_immed =  (inst >> 15) & 0x0000001F;
-    
-    if (GET_BIT(inst,31))
-    {
-        i_immed |= 0xFFFFF000;
-        s_immed |= 0xFFFFF000;
-        b_immed |= 0xFFFFE000;
-        j_immed |= 0xFFE00000;
-    }
+    d->inst = inst;
+    d->rd   = (inst >>  7) & 0x1F;
+    d->rs1  = (inst >> 15) & 0x1F;
+    d->rs2  = (inst >> 20) & 0x1F;
+    d->op   = INS_ILLEGAL;
+    d->imm  = (vluint32_t)0;
     
-    // Signed / unsigned value (for compare / branch)
-    uns_imm = (unsigned long)i_immed;
-    sig_imm = (uns_imm & 0x80000000) ? -((uns_imm ^ 0xFFFFFFFF) + 1) : uns_imm;
-    uns_rs1 = (unsigned long)gp_regs[rs1_idx];
-    sig_rs1 = (uns_rs1 & 0x80000000) ? -((uns_rs1 ^ 0xFFFFFFFF) + 1) : uns_rs1;
-    uns_rs2 = (unsigned long)gp_regs[rs2_idx];
-    sig_rs2 = (uns_rs2 & 0x80000000) ? -((uns_rs2 ^ 0xFFFFFFFF) + 1) : uns_rs2;
+    i_immed = (inst >> 20) & 0x00000FFF;
+    if (GET_BIT(inst,31)) i_immed |= 0xFFFFF000;
     
-    switch (func7)
+    switch (inst & 0x7F)
     {
         // 0x03
         case OPC_LOAD:
         {
-            mem_addr = uns_rs1 + i_immed;
-            mem_xfer = func3;
-            switch (func3)
+            static const vluint8_t load_op[8] =
             {
-                case 0: // LB
-                case 4: // LBU
-                {
-                    mem_mask = (vluint8_t)0x1 << (mem_addr & 3);
-                    pc_reg += 4;
-                    break;
-                }
-                case 1: // LH
-                case 5: // LHU
-                {
-                    if (mem_addr & 1)
-                    {
-                        // Unaligned address
-                        mem_xfer = XFER_NONE;
-                        mem_mask = (vluint8_t)0x0;
-                        except_nr = RAISE_LADDR_ERR;
-                    }
-                    else
-                    {
-                        mem_mask = (vluint8_t)0x3 << (mem_addr & 2);
-                        pc_reg += 4;
-                    }
-                    break;
-                }
-                case 2: // LW
-                {
-                    if (mem_addr & 3)
-                    {
-                        // Unaligned address
-                        mem_xfer = XFER_NONE;
-                        mem_mask = (vluint8_t)0x0;
-                        except_nr = RAISE_LADDR_ERR;
-                    }
-                    else
-                    {
-                        mem_mask = (vluint8_t)0xF;
-                        pc_reg += 4;
-                    }
-                    break;
-                }
-                default:
-                {
-                    // Invalid instruction
-                    mem_xfer = XFER_NONE;
-                    mem_mask = (vluint8_t)0x0;
-                    except_nr = RAISE_ILLEGAL;
-                }
-            }
+                INS_LB,  INS_LH,  INS_LW,      INS_ILL_MEM,
+                INS_LBU, INS_LHU, INS_ILL_MEM, INS_ILL_MEM
+            };
+            d->op  = load_op[func3];
+            d->imm = i_immed;
             break;
         }
         
         // 0x0F
         case OPC_FENCE:
         {
-            pc_reg += 4; // NOP
+            d->op = INS_NOP;
             break;
         }
         
-        // 0x13
-        case OPC_OP_IMM:
-        {
-            switch (func3)
-            {
-                case 0: // ADDI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 + i_immed;
-                    break;
-                }
-                case 1: // SLLI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 << (i_immed & 0x1F);
-                    break;
-                }
-                case 2: // SLTI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = (sig_rs1 < sig_imm) ? 1 : 0;
-                    break;
-                }
-                case 3: // SLTIU
-                {
-                    if (rd_idx) gp_regs[rd_idx] = (uns_rs1 < uns_imm) ? 1 : 0;
-                    break;
-                }
-                case 4: // XORI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 ^ i_immed;
-                    break;
-                }
-                case 5: // SRLI / SRAI
-                {
-                    if (rd_idx)
-                    {
-                        gp_regs[rd_idx] = (GET_BIT(inst,30))
-                                        ? SRA_32(uns_rs1, i_immed & 0x1F)
-                                        : uns_rs1 >> (i_immed & 0x1F);
-                    }
-                    break;
-                }
-                case 6: // ORI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 | i_immed;
-                    break;
-                }
-                case 7: // ANDI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 & i_immed;
-                    break;
-                }
+        // 0x13
+        case OPC_OP_IMM:
+        {
+            static const vluint8_t op_imm_op[8] =
+            {
+                INS_ADDI, INS_SLLI, INS_SLTI, INS_SLTIU,
+                INS_XORI, INS_SRLI, INS_ORI,  INS_ANDI
+            };
+            d->op  = op_imm_op[func3];
+            d->imm = i_immed;
+            if (func3 == 1) d->imm = i_immed & 0x1F;
+            if (func3 == 5)
+            {
+                d->op  = (GET_BIT(inst,30)) ? INS_SRAI : INS_SRLI;
+                d->imm = i_immed & 0x1F;
             }
-            pc_reg += 4;
             break;
         }
         
         // 0x17
-        case OPC_AUIPC: // AUIPC
+        case OPC_AUIPC:
         {
-            if (rd_idx) gp_regs[rd_idx] = pc_reg + u_immed;
-            pc_reg += 4;
+            d->op  = INS_AUIPC;
+            d->imm = inst & 0xFFFFF000;
             break;
         }
         
         // 0x23
         case OPC_STORE:
         {
-            mem_addr = uns_rs1 + s_immed;
-            mem_xfer = func3 + 8;
-            switch (func3)
+            static const vluint8_t store_op[8] =
             {
-                case 0: // SB
-                {
-                    mem_data = (uns_rs2 & 0xFF) * 0x01010101;
-                    mem_mask = (vluint8_t)0x1 << (mem_addr & 3);
-                    pc_reg += 4;
-                    break;
-                }
-                case 1: // SH
-                {
-                    if (mem_addr & 1)
-                    {
-                        // Unaligned address
-                        mem_xfer = XFER_NONE;
-                        mem_mask = (vluint8_t)0x0;
-                        except_nr = RAISE_SADDR_ERR;
-                    }
-                    else
-                    {
-                        mem_data = (uns_rs2 & 0xFFFF) * 0x00010001;
-                        mem_mask = (vluint8_t)0x3 << (mem_addr & 2);
-                        pc_reg += 4;
-                    }
-                    break;
-                }
-                case 2: // SW
-                {
-                    if (mem_addr & 3)
-                    {
-                        // Unaligned address
-                        mem_xfer = XFER_NONE;
-                        mem_mask = (vluint8_t)0x0;
-                        except_nr = RAISE_SADDR_ERR;
-                    }
-                    else
-                    {
-                        mem_data = uns_rs2;
-                        mem_mask = (vluint8_t)0xF;
-                        pc_reg += 4;
-                    }
-                    break;
-                }
-                default:
-                {
-                    // Invalid instruction
-                    mem_xfer = XFER_NONE;
-                    mem_mask = (vluint8_t)0x0;
-                    except_nr = RAISE_ILLEGAL;
-                }
-            }
+                INS_SB,      INS_SH,      INS_SW,      INS_ILL_MEM,
+                INS_ILL_MEM, INS_ILL_MEM, INS_ILL_MEM, INS_ILL_MEM
+            };
+            d->op  = store_op[func3];
+            d->imm = ((inst >> 20) & 0x00000FE0)
+                   | ((inst >>  7) & 0x0000001F);
+            if (GET_BIT(inst,31)) d->imm |= 0xFFFFF000;
             break;
         }
         
         // 0x33
         case OPC_OP:
         {
-            switch (func3)
+            static const vluint8_t op_op[8] =
             {
-                case 0: // ADD / SUB
-                {
-                    if (rd_idx)
-                    {
-                        gp_regs[rd_idx] = (GET_BIT(inst,30))
-                                        ? uns_rs1 - uns_rs2
-                                        : uns_rs1 + uns_rs2;
-                    }
-                    break;
-                }
-                case 1: // SLL
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 << (uns_rs2 & 0x1F);
-                    break;
-                }
-                case 2: // SLT
-                {
-                    if (rd_idx) gp_regs[rd_idx] = (sig_rs1 < sig_rs2) ? 1 : 0;
-                    break;
-                }
-                case 3: // SLTU
-                {
-                    if (rd_idx) gp_regs[rd_idx] = (uns_rs1 < uns_rs2) ? 1 : 0;
-                    break;
-                }
-                case 4: // XOR
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 ^ uns_rs2;
-                    break;
-                }
-                case 5: // SRL / SRA
-                {
-                    if (rd_idx)
-                    {
-                        gp_regs[rd_idx] = (GET_BIT(inst,30))
-                                        ? SRA_32(uns_rs1, uns_rs2 & 0x1F)
-                                        : uns_rs1 >> (uns_rs2 & 0x1F);
-                    }
-                    break;
-                }
-                case 6: // OR
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 | uns_rs2;
-                    break;
-                }
-                case 7: // AND
-                {
-                    if (rd_idx) gp_regs[rd_idx] = uns_rs1 & uns_rs2;
-                    break;
-                }
+                INS_ADD, INS_SLL, INS_SLT, INS_SLTU,
+                INS_XOR, INS_SRL, INS_OR,  INS_AND
+            };
+            d->op = op_op[func3];
+            if (GET_BIT(inst,30))
+            {
+                if (func3 == 0) d->op = INS_SUB;
+                if (func3 == 5) d->op = INS_SRA;
             }
-            pc_reg += 4;
             break;
         }
         
         // 0x37
-        case OPC_LUI: // LUI
+        case OPC_LUI:
         {
-            if (rd_idx) gp_regs[rd_idx] = u_immed;
-            pc_reg += 4;
+            d->op  = INS_LUI;
+            d->imm = inst & 0xFFFFF000;
             break;
         }
         
         // 0x63
         case OPC_BRANCH:
         {
-            bool branch;
-            
-            jmp_addr = pc_reg + b_immed;
-            switch (func3)
+            static const vluint8_t branch_op[8] =
             {
-                case 0: // BEQ
-                {
-                    branch = (uns_rs1 == uns_rs2) ? true : false;
-                    break;
-                }
-                case 1: // BNE
-                {
-                    branch = (uns_rs1 != uns_rs2) ? true : false;
-                    break;
-                }
-                case 4: // BLT
-                {
-                    branch = (sig_rs1 < sig_rs2) ? true : false;
-                    break;
-                }
-                case 5: // BGE
-                {
-                    branch = (sig_rs1 >= sig_rs2) ? true : false;
-                    break;
-                }
-                case 6: // BLTU
-                {
-                    branch = (uns_rs1 < uns_rs2) ? true : false;
-                    break;
-                }
-                case 7: // BGEU
-                {
-                    branch = (uns_rs1 >= uns_rs2) ? true : false;
-                    break;
-                }
-                default:
+                INS_BEQ, INS_BNE, INS_ILLEGAL, INS_ILLEGAL,
+                INS_BLT, INS_BGE, INS_BLTU,    INS_BGEU
+            };
+            d->op  = branch_op[func3];
+            d->imm = ((inst >> 19) & 0x00001000)
+                   | ((inst >> 20) & 0x000007E0)
+                   | ((inst >>  7) & 0x0000001E)
+                   | ((inst <<  4) & 0x00000800);
+            if (GET_BIT(inst,31)) d->imm |= 0xFFFFE000;
+            break;
+        }
+        
+        // 0x67
+        case OPC_JALR:
+        {
+            d->op  = INS_JALR;
+            d->imm = i_immed;
+            break;
+        }
+        
+        // 0x6F
+        case OPC_JAL:
+        {
+            d->op  = INS_JAL;
+            d->imm = ((inst >> 11) & 0x00100000)
+                   | ((inst >> 20) & 0x000007FE)
+                   | ((inst >>  9) & 0x00000800)
+                   |  (inst        & 0x000FF000);
+            if (GET_BIT(inst,31)) d->imm |= 0xFFE00000;
+            break;
+        }
+        
+        // 0x73
+        case OPC_SYSTEM:
+        {
+            static const vluint8_t system_op[8] =
+            {
+                INS_NONE,    INS_CSRRW,  INS_CSRRS,  INS_CSRRC,
+                INS_ILLEGAL, INS_CSRRWI, INS_CSRRSI, INS_CSRRCI
+            };
+            // CSR index (the 5-bit immediate is in rs1)
+            d->op  = system_op[func3];
+            d->imm = i_immed & 0xFFF;
+            if ((func3 == 0) && (!d->rd)) // ECALL, EBREAK, MRET, WFI
+            {
+                switch (d->imm)
                 {
-                    // Invalid instruction
-                    except_nr = RAISE_ILLEGAL;
-                    branch = false;
+                    case 0x000: d->op = INS_ECALL;  break;
+                    case 0x001: d->op = INS_EBREAK; break;
+                    case 0x302: d->op = INS_MRET;   break;
+                    default:    d->op = INS_NOP;    break; // WFI, NOP ?
                 }
             }
-            
+            break;
+        }
+    }
+}
+
+/******************************************************************************/
+/** riscv_exec()                                                             **/
+/** ------------------------------------------------------------------------ **/
+/** Execute one decoded instruction (loads complete in riscv_simu_rd())      **/
+/**   d : decoded instruction                                                **/
+/******************************************************************************/
+
+void RISCVTrace::riscv_exec(const trc_dinst_t *d)
+{
+    vluint32_t rs1 = gp_regs[d->rs1];
+    vluint32_t rs2 = gp_regs[d->rs2];
+    vluint32_t res = (vluint32_t)0;
+    bool branch    = false;
+    
+    switch (d->op)
+    {
+        // Loads : address and byte lanes, data comes with the Verilog read
+        case INS_LB:
+        case INS_LBU:
+        {
+            mem_addr = rs1 + d->imm;
+            mem_xfer = (d->op == INS_LB) ? XFER_LB : XFER_LBU;
+            mem_mask = (vluint8_t)0x1 << (mem_addr & 3);
+            pc_reg += 4;
+            return;
+        }
+        case INS_LH:
+        case INS_LHU:
+        {
+            mem_addr = rs1 + d->imm;
+            if (mem_addr & 1)
+            {
+                // Unaligned address
+                mem_xfer = XFER_NONE;
+                mem_mask = (vluint8_t)0x0;
+                except_nr = RAISE_LADDR_ERR;
+            }
+            else
+            {
+                mem_xfer = (d->op == INS_LH) ? XFER_LH : XFER_LHU;
+                mem_mask = (vluint8_t)0x3 << (mem_addr & 2);
+                pc_reg += 4;
+            }
+            return;
+        }
+        case INS_LW:
+        {
+            mem_addr = rs1 + d->imm;
+            if (mem_addr & 3)
+            {
+                // Unaligned address
+                mem_xfer = XFER_NONE;
+                mem_mask = (vluint8_t)0x0;
+                except_nr = RAISE_LADDR_ERR;
+            }
+            else
+            {
+                mem_xfer = XFER_LW;
+                mem_mask = (vluint8_t)0xF;
+                pc_reg += 4;
+            }
+            return;
+        }
+        
+        // Stores : address, byte lanes and data, checked against the Verilog write
+        case INS_SB:
+        {
+            mem_addr = rs1 + d->imm;
+            mem_xfer = XFER_SB;
+            mem_data = (rs2 & 0xFF) * 0x01010101;
+            mem_mask = (vluint8_t)0x1 << (mem_addr & 3);
+            pc_reg += 4;
+            return;
+        }
+        case INS_SH:
+        {
+            mem_addr = rs1 + d->imm;
+            if (mem_addr & 1)
+            {
+                // Unaligned address
+                mem_xfer = XFER_NONE;
+                mem_mask = (vluint8_t)0x0;
+                except_nr = RAISE_SADDR_ERR;
+            }
+            else
+            {
+                mem_xfer = XFER_SH;
+                mem_data = (rs2 & 0xFFFF) * 0x00010001;
+                mem_mask = (vluint8_t)0x3 << (mem_addr & 2);
+                pc_reg += 4;
+            }
+            return;
+        }
+        case INS_SW:
+        {
+            mem_addr = rs1 + d->imm;
+            if (mem_addr & 3)
+            {
+                // Unaligned address
+                mem_xfer = XFER_NONE;
+                mem_mask = (vluint8_t)0x0;
+                except_nr = RAISE_SADDR_ERR;
+            }
+            else
+            {
+                mem_xfer = XFER_SW;
+                mem_data = rs2;
+                mem_mask = (vluint8_t)0xF;
+                pc_reg += 4;
+            }
+            return;
+        }
+        
+        case INS_ILL_MEM:
+        {
+            // Invalid instruction
+            mem_addr = rs1 + d->imm;
+            mem_xfer = XFER_NONE;
+            mem_mask = (vluint8_t)0x0;
+            except_nr = RAISE_ILLEGAL;
+            return;
+        }
+        
+        // Register / immediate operations
+        case INS_ADDI:  res = rs1 + d->imm; break;
+        case INS_SLLI:  res = rs1 << d->imm; break;
+        case INS_SLTI:  res = ((vlsint32_t)rs1 < (vlsint32_t)d->imm) ? 1 : 0; break;
+        case INS_SLTIU: res = (rs1 < d->imm) ? 1 : 0; break;
+        case INS_XORI:  res = rs1 ^ d->imm; break;
+        case INS_SRLI:  res = rs1 >> d->imm; break;
+        case INS_SRAI:  res = SRA_32(rs1, d->imm); break;
+        case INS_ORI:   res = rs1 | d->imm; break;
+        case INS_ANDI:  res = rs1 & d->imm; break;
+        
+        // Register / register operations
+        case INS_ADD:   res = rs1 + rs2; break;
+        case INS_SUB:   res = rs1 - rs2; break;
+        case INS_SLL:   res = rs1 << (rs2 & 0x1F); break;
+        case INS_SLT:   res = ((vlsint32_t)rs1 < (vlsint32_t)rs2) ? 1 : 0; break;
+        case INS_SLTU:  res = (rs1 < rs2) ? 1 : 0; break;
+        case INS_XOR:   res = rs1 ^ rs2; break;
+        case INS_SRL:   res = rs1 >> (rs2 & 0x1F); break;
+        case INS_SRA:   res = SRA_32(rs1, rs2 & 0x1F); break;
+        case INS_OR:    res = rs1 | rs2; break;
+        case INS_AND:   res = rs1 & rs2; break;
+        
+        // Upper immediate
+        case INS_LUI:   res = d->imm; break;
+        case INS_AUIPC: res = pc_reg + d->imm; break;
+        
+        // Conditional branches
+        case INS_BEQ:   branch = (rs1 == rs2); goto do_branch;
+        case INS_BNE:   branch = (rs1 != rs2); goto do_branch;
+        case INS_BLT:   branch = ((vlsint32_t)rs1 <  (vlsint32_t)rs2); goto do_branch;
+        case INS_BGE:   branch = ((vlsint32_t)rs1 >= (vlsint32_t)rs2); goto do_branch;
+        case INS_BLTU:  branch = (rs1 <  rs2); goto do_branch;
+        case INS_BGEU:  branch = (rs1 >= rs2); goto do_branch;
+        do_branch:
+        {
             if (branch)
             {
+                jmp_addr = pc_reg + d->imm;
                 if (jmp_addr & 3)
                 {
                     except_nr = RAISE_IADDR_ERR;
@@ -1258,17 +2602,16 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
             }
             else
             {
-                if (except_nr == RAISE_NONE) pc_reg += 4;
+                pc_reg += 4;
             }
-            
-            break;
+            return;
         }
         
-        // 0x67
-        case OPC_JALR: // JALR
+        // Jumps
+        case INS_JALR:
         {
-            if (rd_idx) gp_regs[rd_idx] = pc_reg + 4;
-            jmp_addr = (uns_rs1 + i_immed) & 0xFFFFFFFE;
+            if (d->rd) gp_regs[d->rd] = pc_reg + 4;
+            jmp_addr = (rs1 + d->imm) & 0xFFFFFFFE;
             if (jmp_addr & 2)
             {
                 except_nr = RAISE_IADDR_ERR;
@@ -1277,14 +2620,12 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
             {
                 pc_reg = jmp_addr;
             }
-            break;
+            return;
         }
-        
-        // 0x6F
-        case OPC_JAL: // JAL
+        case INS_JAL:
         {
-            if (rd_idx) gp_regs[rd_idx] = pc_reg + 4;
-            jmp_addr = pc_reg + j_immed;
+            if (d->rd) gp_regs[d->rd] = pc_reg + 4;
+            jmp_addr = pc_reg + d->imm;
             if (jmp_addr & 3)
             {
                 except_nr = RAISE_IADDR_ERR;
@@ -1293,108 +2634,70 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
             {
                 pc_reg = jmp_addr;
             }
-            break;
+            return;
         }
         
-        // 0x73
-        case OPC_SYSTEM:
+        // System
+        case INS_ECALL:  except_nr = RAISE_ECALL;  return;
+        case INS_EBREAK: except_nr = RAISE_EBREAK; return;
+        case INS_MRET:   pc_reg = csr_regs[CSR_MEPC]; isr_on = false; return;
+        case INS_NOP:    pc_reg += 4; return;
+        case INS_NONE:   return;
+        
+        // CSR accesses
+        case INS_CSRRW:
+        case INS_CSRRS:
+        case INS_CSRRC:
+        case INS_CSRRWI:
+        case INS_CSRRSI:
+        case INS_CSRRCI:
         {
-            int csr = i_immed & 0xFFF;
+            vluint32_t val = (d->op >= INS_CSRRWI) ? (vluint32_t)d->rs1 : rs1;
             
-            switch (func3)
+            if (d->rd) gp_regs[d->rd] = csr_regs[d->imm];
+            switch (d->op)
             {
-                case 0:
-                {
-                    if (!rd_idx) // ECALL, EBREAK, MRET, WFI
-                    {
-                        switch (csr)
-                        {
-                            case 0x000: // ECALL
-                            {
-                                except_nr = RAISE_ECALL;
-                                break;
-                            }
-                            case 0x001: // EBREAK
-                            {
-                                except_nr = RAISE_EBREAK;
-                                break;
-                            }
-                            case 0x105: // WFI (NOP)
-                            {
-                                pc_reg += 4;
-                                break;
-                            }
-                            case 0x302: // MRET
-                            {
-                                pc_reg = csr_regs[CSR_MEPC];
-                                break;
-                            }
-                            default: // NOP ?
-                            {
-                                pc_reg += 4;
-                            }
-                        }
-                    }
-                    break;
-                }
-                case 1: // CSRRW
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] = uns_rs1;
-                    pc_reg += 4;
-                    break;
-                }
-                case 2: // CSRRS
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] |= uns_rs1;
-                    pc_reg += 4;
-                    break;
-                }
-                case 3: // CSRRC
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] &= ~uns_rs1;
-                    pc_reg += 4;
-                    break;
-                }
-                case 5: // CSRRWI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] = z_immed;
-                    pc_reg += 4;
-                    break;
-                }
-                case 6: // CSRRSI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] |= z_immed;
-                    pc_reg += 4;
-                    break;
-                }
-                case 7: // CSRRCI
-                {
-                    if (rd_idx) gp_regs[rd_idx] = csr_regs[csr];
-                    csr_regs[csr] &= ~z_immed;
-                    pc_reg += 4;
-                    break;
-                }
-                default:
-                {
-                    // Invalid instruction
-                    except_nr = RAISE_ILLEGAL;
-                }
+                case INS_CSRRW: case INS_CSRRWI: csr_regs[d->imm]  =  val; break;
+                case INS_CSRRS: case INS_CSRRSI: csr_regs[d->imm] |=  val; break;
+                default:                         csr_regs[d->imm] &= ~val; break;
             }
-            break;
+            pc_reg += 4;
+            return;
         }
-
+        
         default:
         {
             // Invalid instruction
             except_nr = RAISE_ILLEGAL;
+            return;
         }
     }
     
+    // Register write-back
+    if (d->rd) gp_regs[d->rd] = res;
+    pc_reg += 4;
+}
+
+void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
+{
+    trc_dinst_t *d;
+    
+    if (addr != pc_reg)
+    {
+        mismatch(MIS_INST_ADDR, addr, pc_reg);
+    }
+    
+    // Decoded instructions cache, indexed by PC
+    d = &dec_cache[(pc_reg >> 2) & (DEC_CACHE_SIZE - 1)];
+    if ((d->pc != pc_reg) || (d->inst != inst))
+    {
+        riscv_decode(d, inst);
+        d->pc = pc_reg;
+    }
+    rd_idx = d->rd;
+    
+    riscv_exec(d);
+    
     /*
     // Interrupts handling
     if ((ip_reg) && (ie_reg & 1) && (except_nr == RAISE_NONE))
@@ -1406,27 +2709,63 @@ void RISCVTrace::riscv_simu_if(vluint32_t addr, vluint32_t inst)
     // Exceptions handling
     if (except_nr != RAISE_NONE)
     {
-        csr_regs[CSR_MEPC] = pc_reg;
-        if (except_nr == RAISE_ILLEGAL)
-        {
-            csr_regs[CSR_MTVAL] = inst;
-        }
-        else if (except_nr == RAISE_IADDR_ERR)
-        {
-            csr_regs[CSR_MTVAL] = jmp_addr;
-        }
-        else if ((except_nr == RAISE_LADDR_ERR) || (except_nr == RAISE_SADDR_ERR))
-        {
-            csr_regs[CSR_MTVAL] = mem_addr;
-        }
-        else
-        {
-            csr_regs[CSR_MTVAL] = 0;
-        }
-        csr_regs[CSR_MCAUSE] = except_nr;
+        riscv_trap(inst);
+    }
+}
+
+/******************************************************************************/
+/** riscv_irq()                                                              **/
+/** ------------------------------------------------------------------------ **/
+/** Timer interrupt (standalone simulation) : mip.MTIP = tmr_int & mie.MTIE, **/
+/** not nested (jive_csr.v). Returns true when the handler is entered.       **/
+/**   tmr_int : timer interrupt request                                      **/
+/******************************************************************************/
+
+bool RISCVTrace::riscv_irq(bool tmr_int)
+{
+    csr_regs[CSR_MIP] = ((tmr_int) && (csr_regs[CSR_MIE] & 0x80)) ? 0x80 : 0x00;
+    if ((csr_regs[CSR_MIP]) && (!isr_on))
+    {
+        csr_regs[CSR_MEPC]   = pc_reg;
+        csr_regs[CSR_MTVAL]  = 0;
+        csr_regs[CSR_MCAUSE] = RAISE_TIMER_INT;
         pc_reg = csr_regs[CSR_MTVEC];
-        except_nr = RAISE_NONE;
+        isr_on = true;
+        return true;
+    }
+    return false;
+}
+
+/******************************************************************************/
+/** riscv_trap()                                                             **/
+/** ------------------------------------------------------------------------ **/
+/** Enter the exception handler (except_nr, PC of the faulting instruction)  **/
+/**   inst : 32-bit instruction                                              **/
+/******************************************************************************/
+
+void RISCVTrace::riscv_trap(vluint32_t inst)
+{
+    csr_regs[CSR_MEPC] = pc_reg;
+    if (except_nr == RAISE_ILLEGAL)
+    {
+        csr_regs[CSR_MTVAL] = inst;
+    }
+    else if (except_nr == RAISE_IADDR_ERR)
+    {
+        csr_regs[CSR_MTVAL] = jmp_addr;
     }
+    else if ((except_nr == RAISE_LADDR_ERR) || (except_nr == RAISE_SADDR_ERR))
+    {
+        csr_regs[CSR_MTVAL] = mem_addr;
+    }
+    else
+    {
+        csr_regs[CSR_MTVAL] = 0;
+    }
+    csr_regs[CSR_MCAUSE] = except_nr;
+    pc_reg = csr_regs[CSR_MTVEC];
+    except_nr = RAISE_NONE;
+    isr_on = true;
 }
 
 void RISCVTrace::riscv_simu_rd(vluint32_t addr, vluint32_t data)
@@ -1434,8 +2773,7 @@ void RISCVTrace::riscv_simu_rd(vluint32_t addr, vluint32_t data)
     //if (addr != (mem_addr & 0xFFFFFFFC))
     if (addr != mem_addr)
     {
-        fprintf(tfh, "!!! DATA ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, mem_addr);
+        mismatch(MIS_DATA_ADDR, addr, mem_addr);
     }
     
     switch (mem_xfer)
@@ -1501,7 +2839,7 @@ void RISCVTrace::riscv_simu_rd(vluint32_t addr, vluint32_t data)
         }
         default:
         {
-            fprintf(tfh, "!!! DATA TRANSFER TYPE MISMATCH !!!\n");
+            mismatch(MIS_DATA_XFER, 0, 0);
         }
     }
     mem_xfer = XFER_NONE;
@@ -1513,20 +2851,23 @@ void RISCVTrace::riscv_simu_wr(vluint32_t addr, vluint32_t data, vluint8_t mask)
     //if (addr != (mem_addr & 0xFFFFFFFC))
     if (addr != mem_addr)
     {
-        fprintf(tfh, "!!! DATA ADDRESS MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", addr, mem_addr);
+        mismatch(MIS_DATA_ADDR, addr, mem_addr);
     }
     
     if (data != mem_data)
     {
-        fprintf(tfh, "!!! DATA VALUE MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %08X, C-Model : %08X\n", data, mem_data);
+        mismatch(MIS_DATA_VALUE, data, mem_data);
     }
     
     if (mask != mem_mask)
     {
-        fprintf(tfh, "!!! DATA MASK MISMATCH !!!\n");
-        fprintf(tfh, "Verilog : %1X, C-Model : %1X\n", mask, mem_mask);
+        mismatch(MIS_DATA_MASK, mask, mem_mask);
     }
     mem_xfer = XFER_NONE;
+    
+    // Stored into code : drop the decoded instruction
+    if (dec_cache[(addr >> 2) & (DEC_CACHE_SIZE - 1)].pc == (addr & 0xFFFFFFFC))
+    {
+        dec_cache[(addr >> 2) & (DEC_CACHE_SIZE - 1)].pc = (vluint32_t)0xFFFFFFFF;
+    }
 }
\ No newline at end of file
@@ -2,8 +2,150 @@
 #define _RISCV_TRACE_H_
 
 #include "verilated.h"
+#include "verilated_save.h"
+#include "../sym_table/sym_table.h"
+#include "../profiler/profiler.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <zlib.h>
+#include <atomic>
+#include <thread>
+
+// Trace file formats
+enum
+{
+    TRC_FMT_TEXT = 0,   // Text trace (.out32)
+    TRC_FMT_BIN  = 1    // Binary records (.trc32)
+};
+
+// Trace capture trigger types
+enum
+{
+    TRG_NONE  = 0,      // No trigger
+    TRG_PC    = 1,      // Instruction fetch at an address
+    TRG_INSTR = 2,      // Number of instructions executed
+    TRG_TIME  = 3,      // Time stamp (in ps)
+    TRG_WRITE = 4       // Memory write at an address
+};
+
+// Trace capture trigger index
+#define TRG_START   (0)
+#define TRG_STOP    (1)
+
+// Bus and writeback sample captured on a clock rising edge
+typedef struct
+{
+    vluint64_t stamp;       // Time stamp (in ps)
+    vluint32_t i_address;   // Instruction fetch
+    vluint32_t i_rddata;
+    vluint32_t d_address;   // Data read/write
+    vluint32_t d_rddata;
+    vluint32_t d_wrdata;
+    vluint32_t wb_data;     // Register write-back
+    vluint8_t  i_rd_ack;
+    vluint8_t  d_rd_ack;
+    vluint8_t  d_wr_ack;
+    vluint8_t  d_byteena;
+    vluint8_t  wb_ena;
+    vluint8_t  wb_idx;
+} trc_sample_t;
+
+// Instruction kept in the history ring (before the start trigger)
+typedef struct
+{
+    vluint64_t stamp;       // Time stamp (in ps)
+    vluint32_t addr;        // Verilog fetch address
+    vluint32_t inst;        // Instruction
+    vluint32_t pc;          // C-Model PC
+    vluint32_t regs[32];    // C-Model registers
+} trc_hist_t;
+
+// Disassembly cache entry
+typedef struct
+{
+    vluint32_t inst;        // Instruction
+    vluint32_t pc;          // Instruction address
+    vluint32_t text[8];     // 32 characters, 1st one in LSB of text[0]
+} trc_dasm_t;
+
+// Disassembly cache size (power of 2)
+#define DASM_CACHE_SIZE (4096)
+
+// Symbol names : characters kept in the disassembly (branch / jump targets)
+// and in the text trace (function of the fetch address)
+#define DASM_SYM_LEN    (24)
+#define TRC_SYM_LEN     (48)
+
+// Decoded instruction operations
+enum
+{
+    INS_ILLEGAL = 0,    // Invalid instruction
+    INS_NOP,            // FENCE, WFI
+    INS_NONE,           // SYSTEM with rd != 0 (PC not updated)
+    INS_ILL_MEM,        // Invalid load/store width
+    INS_LB,   INS_LH,   INS_LW,   INS_LBU,  INS_LHU,
+    INS_SB,   INS_SH,   INS_SW,
+    INS_ADDI, INS_SLLI, INS_SLTI, INS_SLTIU,
+    INS_XORI, INS_SRLI, INS_SRAI, INS_ORI,  INS_ANDI,
+    INS_ADD,  INS_SUB,  INS_SLL,  INS_SLT,  INS_SLTU,
+    INS_XOR,  INS_SRL,  INS_SRA,  INS_OR,   INS_AND,
+    INS_LUI,  INS_AUIPC,
+    INS_BEQ,  INS_BNE,  INS_BLT,  INS_BGE,  INS_BLTU, INS_BGEU,
+    INS_JALR, INS_JAL,
+    INS_ECALL, INS_EBREAK, INS_MRET,
+    INS_CSRRW,  INS_CSRRS,  INS_CSRRC,
+    INS_CSRRWI, INS_CSRRSI, INS_CSRRCI,
+    INS_COUNT
+};
+
+// Decoded instruction (cache entry)
+typedef struct
+{
+    vluint32_t pc;          // Instruction address
+    vluint32_t inst;        // Instruction
+    vluint32_t imm;         // Sign extended immediate or CSR index
+    vluint8_t  op;          // Operation (INS_xxx)
+    vluint8_t  rd;          // Destination register
+    vluint8_t  rs1;         // Source registers (rs1 : 5-bit CSR immediate)
+    vluint8_t  rs2;
+} trc_dinst_t;
+
+// Decoded instructions cache size (power of 2)
+#define DEC_CACHE_SIZE  (4096)
+
+// Translated basic block
+#define BLK_MAX_INS     (32)        // Instructions per block
+#define BLK_NO_STOP     ((vluint32_t)0xFFFFFFFF) // run() : no stop PC
+#define BLK_CACHE_SIZE  (2048)      // Blocks (power of 2)
+#define BLK_PAGE_BITS   (8)         // Code pages of 256 bytes
+
+// Translated instruction : handler address and decoded instruction
+typedef struct
+{
+    const void *lbl;        // Handler (threaded dispatch)
+    trc_dinst_t d;          // Decoded instruction
+} trc_bins_t;
+
+// Translated basic block (ends on a jump, a trap, a CSR access or BLK_MAX_INS)
+typedef struct
+{
+    vluint32_t pc;          // First instruction address
+    vluint32_t len;         // Number of instructions
+    trc_bins_t ins[BLK_MAX_INS + 1]; // + block exit
+} trc_block_t;
+
+// Memory bus for the standalone simulation (no Verilog model)
+class RISCVBus
+{
+    public:
+        virtual ~RISCVBus() {}
+        // 32-bit read (address is word aligned by the bus)
+        virtual vluint32_t read(vluint32_t addr) = 0;
+        // Masked 32-bit write (data replicated on the enabled bytes)
+        virtual void       write(vluint32_t addr, vluint32_t data, vluint8_t mask) = 0;
+        // RAM directly accessible by the ISS (NULL : none)
+        virtual vluint8_t *direct(vluint32_t *base, vluint32_t *size) { return NULL; }
+};
 
 class RISCVTrace
 {
@@ -12,27 +154,97 @@ class RISCVTrace
         RISCVTrace(vluint32_t reset_vect, vluint32_t comp_data_beg, vluint32_t comp_data_end);
         ~RISCVTrace();
         // Methods
+        void setFormat(int fmt);
+        void setTrigger(int idx, int type, vluint64_t value);
+        void setHistory(int depth);
+        void setSegmentSize(vluint64_t max_bytes);
+        void setCompression(int level);
+        void setFailFast(const char *name, int depth);
+        void setSymbols(SymTable *syms);
+        void setProfiler(Profiler *profiler);
+        bool failed(void);
+        bool halted(void);
+        int  compareSignature(const char *name);
         int  open(const char *name);
+        int  openSignature(const char *name);
         int  openNext(void);
         void close(void);
+        void save(VerilatedSerialize &os);
+        int  restore(VerilatedDeserialize &is);
         void dump(vluint64_t stamp,     vluint8_t  clk,
                   vluint8_t  i_rd_ack,  vluint32_t i_address, vluint32_t i_rddata,
                   vluint8_t  d_rd_ack,  vluint8_t  d_wr_ack,  vluint32_t d_address,
                   vluint8_t  d_byteena, vluint32_t d_rddata,  vluint32_t d_wrdata,
                   vluint32_t inr_ir_irq,
                   vluint8_t  wb_ena,    vluint8_t  wb_idx,    vluint32_t wb_data);
-        char disasm(vluint32_t inst, vluint32_t pc, int idx);
+        void sample(vluint64_t stamp,
+                    vluint8_t  i_rd_ack,  vluint32_t i_address, vluint32_t i_rddata,
+                    vluint8_t  d_rd_ack,  vluint8_t  d_wr_ack,  vluint32_t d_address,
+                    vluint8_t  d_byteena, vluint32_t d_rddata,  vluint32_t d_wrdata,
+                    vluint32_t inr_ir_irq,
+                    vluint8_t  wb_ena,    vluint8_t  wb_idx,    vluint32_t wb_data);
+        int  startWorker(vluint32_t ring_size);
+        void stopWorker(void);
+        int  step(RISCVBus *bus, bool tmr_int);
+        vluint32_t run(RISCVBus *bus, bool tmr_int, vluint32_t max_inst, bool *dead, vluint32_t stop_pc);
+        vluint32_t getReg(int idx);
+        vluint32_t getPc(void);
+        vluint32_t getCsr(int csr);
+        bool inIsr(void);
+        vluint64_t getInstCount(void);
+        void skipInstr(vluint64_t num);
+        void disasm(vluint32_t inst, vluint32_t pc, vluint32_t *text);
+        int  decode(const char *bin_name, const char *txt_name);
     private:
+        // Lockstep checking and trace output
+        void        process(const trc_sample_t *smp);
+        void        worker_loop(void);
+        // Trace capture triggers
+        bool        trigger(int idx, const trc_sample_t *smp);
+        void        emit_fetch(vluint64_t stamp, vluint32_t addr, vluint32_t inst, vluint32_t pc, const vluint32_t *regs);
+        void        hist_flush(void);
+        void        hist_push(trc_hist_t *ring, int size, int *idx, int *cnt,
+                              vluint64_t stamp, vluint32_t addr, vluint32_t inst);
+        void        sig_write(vluint32_t addr, vluint32_t data, vluint8_t mask);
+        // Trace segments
+        int         open_segment(void);
+        void        close_segment(void);
+        void        trc_write(const char *buf, int len);
         // Utility functions
-        char       *uhex_to_str(vluint32_t val, int dig);
-        char       *shex_to_str(vluint32_t val, int dig);
-        char       *get_csr_str(int csr);
+        char       *uhex_to_str(char *buf, vluint32_t val, int dig);
+        char       *shex_to_str(char *buf, vluint32_t val, int dig);
+        char       *get_csr_str(char *buf, int csr);
+        int         sym_str(char *buf, vluint32_t addr, int max_len);
+        // Text trace output
+        int         txt_regs(char *buf, const vluint32_t *regs);
+        int         txt_fetch(char *buf, vluint64_t stamp, vluint32_t addr, vluint32_t inst, vluint32_t pc);
+        int         txt_mem_rd(char *buf, vluint32_t addr, vluint32_t data);
+        int         txt_mem_wr(char *buf, vluint32_t addr, vluint32_t data, vluint8_t mask);
+        int         txt_mismatch(char *buf, vluint64_t stamp, int kind, vluint32_t rtl, vluint32_t model);
+        // Binary trace output
+        void        bin_header(void);
+        void        bin_record(vluint8_t tag, vluint64_t stamp);
+        void        bin_put32(vluint32_t val);
+        void        bin_flush(void);
+        void        bin_regs(const vluint32_t *regs);
+        // Mismatch report
+        void        mismatch(int kind, vluint32_t rtl, vluint32_t model);
+        void        fail_report(int kind, vluint32_t rtl, vluint32_t model);
         // RISC-V disassembler
         void        riscv_dasm(char *buf, vluint32_t inst, vluint32_t pc);
         // RISC-V simulator
+        void        riscv_decode(trc_dinst_t *d, vluint32_t inst);
+        void        riscv_exec(const trc_dinst_t *d);
+        void        riscv_trap(vluint32_t inst);
+        bool        riscv_irq(bool tmr_int);
         void        riscv_simu_if(vluint32_t addr, vluint32_t inst);
         void        riscv_simu_rd(vluint32_t addr, vluint32_t data);
         void        riscv_simu_wr(vluint32_t addr, vluint32_t data, vluint8_t mask);
+        // Call graph event for the guest profiler
+        void        prof_flow(vluint32_t addr, vluint32_t inst, bool isr_prev);
+        // Basic blocks translation (riscv_block.cpp)
+        trc_block_t *blk_build(RISCVBus *bus, vluint32_t pc);
+        void        blk_flush(void);
         // General purpose registers
         vluint32_t  gp_regs[32];
         // Program counter
@@ -44,16 +256,81 @@ class RISCVTrace
         vluint8_t  *test_ptr;
         // CSR registers
         vluint32_t  csr_regs[4096];
-        // Disassembly buffer
-        char        dasm_buf[32];
-        // Trace file handle
+        // Program symbols (NULL : addresses only)
+        SymTable   *sym_tab;
+        // Guest profiler (NULL : disabled)
+        Profiler   *prof;
+        // Disassembly cache
+        trc_dasm_t  dasm_cache[DASM_CACHE_SIZE];
+        // Decoded instructions cache
+        trc_dinst_t dec_cache[DEC_CACHE_SIZE];
+        // Translated blocks cache, code pages in RAM, RAM window
+        trc_block_t *blk_cache;
+        vluint8_t  *blk_code;
+        vluint8_t  *blk_ram;
+        vluint32_t  blk_ram_base;
+        vluint32_t  blk_ram_size;
+        // Trace file handle (plain or compressed)
+        char        bname[256];
         char        tname[256];
         FILE       *tfh;
+        gzFile      tgz;
+        int         gz_level;
+        // Trace segments : size limit, manifest and current segment range
+        vluint64_t  seg_limit;
+        vluint64_t  seg_bytes;
+        int         seg_num;
+        FILE       *mfh;
+        vluint64_t  seg_fetch;
+        vluint64_t  seg_beg_ps;
+        vluint64_t  seg_end_ps;
+        vluint32_t  seg_min_pc;
+        vluint32_t  seg_max_pc;
+        // Trace file format
+        int         trc_fmt;
+        // Current time stamp (in ps)
+        vluint64_t  curr_stamp;
+        // Binary trace : last time stamp, last fetch address, registers shadow
+        vluint64_t  bin_stamp;
+        vluint32_t  bin_pc;
+        vluint32_t  bin_gp_regs[32];
+        // Binary trace : record being built
+        vluint8_t   bin_buf[32];
+        int         bin_len;
         // Output file handle
         char        oname[256];
         FILE       *ofh;
         // Exception number
         vluint32_t  except_nr;
+        // Exception / interrupt handler running (until MRET)
+        bool        isr_on;
+        // Trace capture triggers (start, stop)
+        int         trg_type[2];
+        vluint64_t  trg_value[2];
+        bool        trg_fired[2];
+        bool        capture;
+        vluint64_t  inst_cnt;
+        // Instructions history ring
+        trc_hist_t *hist_buf;
+        int         hist_size;
+        int         hist_cnt;
+        int         hist_idx;
+        // Fail-fast : report file, last instructions ring, first mismatch seen
+        char        fname[256];
+        trc_hist_t *fail_buf;
+        int         fail_size;
+        int         fail_cnt;
+        int         fail_idx;
+        std::atomic<bool> fail_hit;
+        // Jump to itself with the timer interrupt disabled (end of test)
+        std::atomic<bool> halt_hit;
+        // Worker thread and its single-producer / single-consumer ring
+        std::thread            *worker;
+        trc_sample_t           *smp_ring;
+        vluint32_t              smp_size;
+        std::atomic<vluint32_t> smp_head;
+        std::atomic<vluint32_t> smp_tail;
+        std::atomic<bool>       smp_stop;
         // Previous clock state
         vluint8_t   prev_clk;
         // Register writeback
@@ -66,6 +343,8 @@ class RISCVTrace
         vluint32_t  mem_addr;
         // Memory data (store)
         vluint32_t  mem_data;
+        // Jump address (branch/jump)
+        vluint32_t  jmp_addr;
 };
 
 #endif /* _RISCV_TRACE_H_ */
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "verilated.h"
+#include "sym_table.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+
+// Constructor
+SymTable::SymTable()
+{
+    num_sym = 0;
+    max_sym = 0;
+    p_sym   = NULL;
+    num_rng = 0;
+    p_rng   = NULL;
+}
+
+// Destructor
+SymTable::~SymTable()
+{
+    for (int i = 0; i < num_sym; i++)
+    {
+        delete [] p_sym[i].name;
+    }
+    delete [] p_sym;
+    delete [] p_rng;
+}
+
+// Add a symbol
+void SymTable::add(const char *name, vluint32_t addr, vluint32_t size)
+{
+    if (num_sym == max_sym)
+    {
+        sym_entry_t *p_tmp;
+        
+        max_sym = (max_sym) ? max_sym * 2 : 256;
+        p_tmp = new sym_entry_t[max_sym];
+        if (num_sym) memcpy(p_tmp, p_sym, num_sym * sizeof(sym_entry_t));
+        delete [] p_sym;
+        p_sym = p_tmp;
+    }
+    
+    p_sym[num_sym].name = new char[strlen(name) + 1];
+    strcpy(p_sym[num_sym].name, name);
+    p_sym[num_sym].addr = addr;
+    p_sym[num_sym].size = size;
+    num_sym++;
+    
+    // Index built again by buildIndex()
+    num_rng = 0;
+}
+
+// Load a symbols file ("objdump -t" or "nm" text output)
+int SymTable::loadSyms(const char *name)
+{
+    FILE *fh;
+    char line[512];
+    
+    fh = fopen(name, "r");
+    if (!fh) return -1;
+    
+    while (fgets(line, sizeof(line), fh))
+    {
+        char *tok[8];
+        char *end;
+        char *save;
+        char *p;
+        int   num;
+        vluint32_t addr;
+        vluint32_t size;
+        
+        // Split the line into tokens
+        num = 0;
+        p = strtok_r(line, " \t\r\n", &save);
+        while ((p) && (num < 8))
+        {
+            tok[num++] = p;
+            p = strtok_r(NULL, " \t\r\n", &save);
+        }
+        if (num < 3) continue;
+        
+        // First token : address
+        addr = (vluint32_t)strtoul(tok[0], &end, 16);
+        if ((*end) || (end == tok[0])) continue;
+        
+        // Token before the name : size ("objdump -t" only)
+        size = 0;
+        if (num >= 4)
+        {
+            size = (vluint32_t)strtoul(tok[num-2], &end, 16);
+            if (*end) size = 0;
+        }
+        
+        // Source file name ("objdump -t" flags "df")
+        if ((num >= 5) && (!strcmp(tok[2], "df"))) continue;
+        
+        // Last token : name
+        add(tok[num-1], addr, size);
+    }
+    fclose(fh);
+    
+    return 0;
+}
+
+// Find a symbol address from its name
+int SymTable::find(const char *name, vluint32_t *addr)
+{
+    for (int i = 0; i < num_sym; i++)
+    {
+        if (!strcmp(p_sym[i].name, name))
+        {
+            *addr = p_sym[i].addr;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Number of symbols
+int SymTable::count(void)
+{
+    return num_sym;
+}
+
+/******************************************************************************/
+/** Sort the symbols by address into intervals for lookup() : a symbol       **/
+/** covers its size, or up to the next symbol when its size is unknown.      **/
+/** Section names (".text") and mapping symbols ("$x") are left out, the     **/
+/** symbol with a size is kept when several ones share an address.           **/
+/** To be called again after add() / loadSyms(), before any lookup().        **/
+/** Returns the number of intervals                                          **/
+/******************************************************************************/
+int SymTable::buildIndex(void)
+{
+    const sym_entry_t *sym = p_sym;
+    vluint32_t outer;
+    int num;
+    
+    delete [] p_rng;
+    p_rng   = new sym_range_t[num_sym + 1];
+    num_rng = 0;
+    
+    num = 0;
+    for (int i = 0; i < num_sym; i++)
+    {
+        if ((p_sym[i].name[0] == '.') || (p_sym[i].name[0] == '$')) continue;
+        p_rng[num].beg = p_sym[i].addr;
+        p_rng[num].sym = i;
+        num++;
+    }
+    
+    // By address, then symbols without a size first (same order otherwise)
+    std::stable_sort(p_rng, p_rng + num, [sym](const sym_range_t &a, const sym_range_t &b)
+    {
+        if (a.beg != b.beg) return a.beg < b.beg;
+        return (sym[a.sym].size == 0) && (sym[b.sym].size != 0);
+    });
+    
+    // Last symbol of each address kept
+    for (int i = 0; i < num; i++)
+    {
+        if ((i + 1 < num) && (p_rng[i + 1].beg == p_rng[i].beg)) continue;
+        p_rng[num_rng++] = p_rng[i];
+    }
+    
+    // Interval ends (a label inside a function ends with the function)
+    outer = 0;
+    for (int i = 0; i < num_rng; i++)
+    {
+        vluint32_t size = p_sym[p_rng[i].sym].size;
+        
+        if (size)
+        {
+            p_rng[i].end = p_rng[i].beg + size;
+            if (p_rng[i].end < p_rng[i].beg) p_rng[i].end = 0xFFFFFFFF;
+            outer = p_rng[i].end;
+        }
+        else
+        {
+            p_rng[i].end = (i + 1 < num_rng) ? p_rng[i + 1].beg : p_rng[i].beg + 1;
+            if ((outer > p_rng[i].beg) && (outer < p_rng[i].end)) p_rng[i].end = outer;
+        }
+    }
+    
+    return num_rng;
+}
+
+/******************************************************************************/
+/** Symbol covering an address (binary search of the buildIndex() intervals) **/
+/**   addr : address                                                         **/
+/**   name : symbol name                                                     **/
+/**   offs : offset from the symbol address                                  **/
+/** Returns 0 or -1 (no symbol)                                              **/
+/******************************************************************************/
+int SymTable::lookup(vluint32_t addr, const char **name, vluint32_t *offs) const
+{
+    int lo = 0;
+    int hi = num_rng;
+    
+    // Last interval starting at or before the address
+    while (lo < hi)
+    {
+        int mid = (lo + hi) >> 1;
+        
+        if (p_rng[mid].beg <= addr) lo = mid + 1; else hi = mid;
+    }
+    if ((!lo) || (addr >= p_rng[lo - 1].end)) return -1;
+    
+    *name = p_sym[p_rng[lo - 1].sym].name;
+    *offs = addr - p_rng[lo - 1].beg;
+    
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef _SYM_TABLE_H_
+#define _SYM_TABLE_H_
+
+#include "verilated.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+// Program symbol
+typedef struct
+{
+    char       *name;   // Symbol name
+    vluint32_t  addr;   // Symbol address
+    vluint32_t  size;   // Symbol size (0 : unknown)
+} sym_entry_t;
+
+// Address interval covered by a symbol (sorted index)
+typedef struct
+{
+    vluint32_t  beg;    // First address
+    vluint32_t  end;    // Last address + 1 (symbol size or next symbol)
+    int         sym;    // Symbol entry
+} sym_range_t;
+
+class SymTable
+{
+    public:
+        // Constructor and destructor
+        SymTable();
+        ~SymTable();
+        // Methods
+        int         loadSyms(const char *name);
+        void        add(const char *name, vluint32_t addr, vluint32_t size);
+        int         find(const char *name, vluint32_t *addr);
+        int         count(void);
+        int         buildIndex(void);
+        int         lookup(vluint32_t addr, const char **name, vluint32_t *offs) const;
+    private:
+        int         num_sym;    // Number of symbols
+        int         max_sym;    // Allocated entries
+        sym_entry_t *p_sym;     // Symbols
+        int         num_rng;    // Number of intervals (0 : no index)
+        sym_range_t *p_rng;     // Intervals sorted by address
+};
+
+#endif /* _SYM_TABLE_H_ */
@@ -0,0 +1,59 @@
+#include "verilated.h"
+#include "../riscv_trace/riscv_trace.h"
+#include "../sym_table/sym_table.h"
+#include "../mem_load/mem_load.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Binary trace (.trc32) to text trace (.out32) converter
+int main(int argc, char **argv)
+{
+    RISCVTrace *trc;
+    SymTable *syms;
+    const char *name[2];
+    int num;
+    int ret;
+    
+    // Trace files, symbols from a +syms=<file> or a +elf=<file> parameter
+    syms = new SymTable();
+    num  = 0;
+    ret  = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strncmp(argv[i], "+syms=", 6))
+        {
+            if (syms->loadSyms(argv[i] + 6))
+            {
+                printf("Cannot open \"%s\" !\n", argv[i] + 6);
+                ret = -1;
+            }
+        }
+        else if (!strncmp(argv[i], "+elf=", 5))
+        {
+            ret |= read_elf(argv[i] + 5, NULL, 0, syms, NULL);
+        }
+        else if (num < 2)
+        {
+            name[num++] = argv[i];
+        }
+        else
+        {
+            num = 3;
+        }
+    }
+    if ((ret) || (num < 1) || (num > 2))
+    {
+        printf("Usage : %s <trace.trc32> [<trace.out32>] [+syms=<file>] [+elf=<file>]\n", argv[0]);
+        delete syms;
+        return 1;
+    }
+    
+    trc = new RISCVTrace(0x80000000, 0, 0);
+    trc->setSymbols(syms);
+    ret = trc->decode(name[0], (num == 2) ? name[1] : NULL);
+    delete trc;
+    delete syms;
+    
+    return (ret) ? 1 : 0;
+}